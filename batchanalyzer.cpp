@@ -0,0 +1,100 @@
+#include "batchanalyzer.h"
+
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadPool>
+
+BatchAnalyzer::BatchAnalyzer()
+    : includeCache(new IncludeCache)
+{
+}
+
+void BatchAnalyzer::setThreadCount(int count)
+{
+    threadCount = count;
+}
+
+void BatchAnalyzer::setIncludeCache(const QSharedPointer<IncludeCache> &cache)
+{
+    includeCache = cache;
+}
+
+int BatchAnalyzer::run(const QStringList &paths, const FileTask &task, const ResultHandler &handler)
+{
+    int fileNum = paths.size();
+    if(fileNum == 0) { return 0; }
+    int workerNum = threadCount > 0 ? threadCount : QThread::idealThreadCount();
+    workerNum = qBound(1, workerNum, fileNum);
+
+    results = std::vector<FileResult>(size_t(fileNum));
+    for(int i = 0; i < fileNum; i++) { results[size_t(i)].path = paths.at(i); }
+    finished.assign(size_t(fileNum), false);
+    // 相邻文件往往包含相同的头文件，按连续区间分配以提高缓存命中
+    std::vector<WorkQueue>(size_t(workerNum)).swap(queues);
+    for(int k = 0; k < workerNum; k++) {
+        queues[size_t(k)].head = int(qint64(fileNum) * k / workerNum);
+        queues[size_t(k)].tail = int(qint64(fileNum) * (k + 1) / workerNum);
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(workerNum);
+    for(int k = 0; k < workerNum; k++) {
+        pool.start([this, k, &task]() { processFiles(k, task); });
+    }
+
+    int failedNum = 0;
+    for(int i = 0; i < fileNum; i++) {
+        {
+            QMutexLocker locker(&resultMutex);
+            while(!finished[size_t(i)]) { resultReady.wait(&resultMutex); }
+        }
+        FileResult & result = results[size_t(i)];
+        if(!result.ok) { failedNum++; }
+        handler(i, result);
+        result = FileResult();
+    }
+    pool.waitForDone();
+    results.clear();
+    finished.clear();
+    return failedNum;
+}
+
+int BatchAnalyzer::takeFile(int worker)
+{
+    {
+        WorkQueue & own = queues[size_t(worker)];
+        QMutexLocker locker(&own.mutex);
+        if(own.head < own.tail) { return own.head++; }
+    }
+    // 从相邻线程开始依次尝试，避免空闲线程同时争抢同一个队列
+    int workerNum = int(queues.size());
+    for(int step = 1; step < workerNum; step++) {
+        WorkQueue & victim = queues[size_t((worker + step) % workerNum)];
+        QMutexLocker locker(&victim.mutex);
+        if(victim.head < victim.tail) { return --victim.tail; }
+    }
+    return -1;
+}
+
+void BatchAnalyzer::processFiles(int worker, const FileTask &task)
+{
+    LexAnalyzer util;
+    util.setIncludeCache(includeCache);
+    int index = 0;
+    while((index = takeFile(worker)) >= 0) {
+        FileResult & result = results[size_t(index)];
+        SourceFile file;
+        if(!file.open(result.path)) {
+            result.errorMsg = "无法打开文件";
+        } else {
+            // 相对路径的 #include 以源文件所在目录为准
+            util.setIncludeDir(QFileInfo(result.path).absolutePath());
+            result.ok = task(util, file, result.output);
+            if(!result.ok) { result.errorMsg = util.getErrorMsg(); }
+        }
+        QMutexLocker locker(&resultMutex);
+        finished[size_t(index)] = true;
+        resultReady.wakeAll();
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef BATCHANALYZER_H
+#define BATCHANALYZER_H
+
+#include <functional>
+#include <vector>
+
+#include <QByteArray>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QWaitCondition>
+
+#include "includecache.h"
+#include "lexanalyzer.h"
+#include "sourcefile.h"
+
+/**
+ * @brief 多文件批处理调度器
+ * @details 输入文件按顺序均分给各工作线程的本地队列，工作线程从本队列头部依次取文件，
+ *  本队列取空后从其他线程队列的尾部窃取，文件耗时不均时各线程仍能同时结束
+ *  每个工作线程持有独立的 LexAnalyzer，所有线程共用一份包含文件缓存，
+ *  各文件的结果与错误在调用线程中按输入顺序交付，交付后立即释放
+ */
+class BatchAnalyzer
+{
+public:
+    /**
+     * @brief 单个文件的处理结果
+     */
+    struct FileResult {
+        QString path;           // 输入文件路径
+        bool ok = false;        // 是否处理成功
+        QString errorMsg;       // 失败时的错误信息
+        QByteArray output;      // 处理任务生成的输出
+    };
+
+    /**
+     * @brief FileTask 在工作线程中处理单个文件的任务
+     * @details 参数依次为本线程的分析器、已打开的源码文件与输出，返回是否成功，
+     *  失败时以分析器的错误信息作为该文件的错误
+     */
+    using FileTask = std::function<bool(LexAnalyzer &, const SourceFile &, QByteArray &)>;
+    /**
+     * @brief ResultHandler 在调用线程中按输入顺序接收各文件结果
+     * @details 参数依次为文件在输入中的序号与处理结果
+     */
+    using ResultHandler = std::function<void(int, FileResult &)>;
+
+    BatchAnalyzer();
+
+    /**
+     * @brief setThreadCount 设置工作线程数
+     * @param count 线程数，不大于 0 时使用 QThread::idealThreadCount
+     */
+    void setThreadCount(int count);
+
+    /**
+     * @brief setIncludeCache 设置各工作线程共用的包含文件缓存，可在多次批处理之间保留
+     * @param cache 包含文件缓存
+     */
+    void setIncludeCache(const QSharedPointer<IncludeCache> & cache);
+
+    /**
+     * @brief run 处理一批文件
+     * @details 相对路径的 #include 以各源文件所在目录为准，返回前所有工作线程均已结束
+     * @param paths 输入文件路径
+     * @param task 处理任务
+     * @param handler 结果接收者
+     * @return 处理失败的文件数
+     */
+    int run(const QStringList & paths, const FileTask & task, const ResultHandler & handler);
+
+private:
+    /**
+     * @brief 工作线程的本地队列
+     * @details 队列中是输入序号的连续区间 [head, tail)，所有者从 head 取，窃取者从 tail 取
+     */
+    struct WorkQueue {
+        QMutex mutex;   // 保护 head 与 tail
+        int head = 0;   // 所有者下一个处理的序号
+        int tail = 0;   // 区间末尾
+    };
+
+    int threadCount = 0;    // 工作线程数
+    QSharedPointer<IncludeCache> includeCache;  // 各工作线程共用的包含文件缓存
+    std::vector<WorkQueue> queues;      // 各工作线程的本地队列
+    std::vector<FileResult> results;    // 尚未交付的结果
+    std::vector<bool> finished;         // 各文件是否已处理完毕
+    QMutex resultMutex;                 // 保护 finished
+    QWaitCondition resultReady;         // 有文件处理完毕
+
+    /**
+     * @brief takeFile 为工作线程取下一个文件，本队列为空时窃取
+     * @param worker 工作线程序号
+     * @return 输入序号，所有队列都为空时返回 -1
+     */
+    int takeFile(int worker);
+    /**
+     * @brief processFiles 工作线程主函数
+     * @param worker 工作线程序号
+     * @param task 处理任务
+     */
+    void processFiles(int worker, const FileTask & task);
+};
+
+#endif // BATCHANALYZER_H
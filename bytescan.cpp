@@ -0,0 +1,347 @@
+#include "bytescan.h"
+
+#include <cstring>
+
+#include <QByteArray>
+#include <QtAlgorithms>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BYTESCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 实现依赖 GCC/Clang 的 target 属性，不要求以 -mavx2 编译整个项目
+#if defined(BYTESCAN_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define BYTESCAN_AVX2
+#include <immintrin.h>
+#define BYTESCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace ByteScan {
+
+namespace {
+
+// 逐字节实现，也用于向量实现处理末尾不足一个向量的部分
+
+const char *findSpecialScalar(const char *begin, const char *end)
+{
+    for(; begin < end; begin++) {
+        if(!(flagTable.value[uchar(*begin)] & FlagSpecial)) { continue; }
+        if(!isLoneSpace(begin, end)) { break; }
+    }
+    return begin;
+}
+
+const char *skipWhiteScalar(const char *begin, const char *end)
+{
+    while(begin < end && (flagTable.value[uchar(*begin)] & FlagWhite)) { begin++; }
+    return begin;
+}
+
+const char *findCommentEndScalar(const char *begin, const char *end)
+{
+    while(begin + 1 < end) {
+        const void *star = memchr(begin, '*', size_t(end - begin - 1));
+        if(star == nullptr) { break; }
+        begin = static_cast<const char *>(star);
+        if(begin[1] == '/') { return begin; }
+        begin++;
+    }
+    return end;
+}
+
+const char *skipIdCharsScalar(const char *begin, const char *end)
+{
+    while(begin < end && (flagTable.value[uchar(*begin)] & FlagId)) { begin++; }
+    return begin;
+}
+
+const char *skipNumberCharsScalar(const char *begin, const char *end)
+{
+    while(begin < end && (flagTable.value[uchar(*begin)] & FlagNumber)) { begin++; }
+    return begin;
+}
+
+const char *findStringEndScalar(const char *begin, const char *end)
+{
+    while(begin < end && *begin != '"' && *begin != 0) { begin++; }
+    return begin;
+}
+
+#ifdef BYTESCAN_SSE2
+
+/**
+ * @brief inRange16 16 个字节中落在 [low, high] 内的字节
+ * @details 减去 low 后按无符号数饱和减去 high - low，结果为 0 的字节在区间内
+ */
+inline __m128i inRange16(__m128i bytes, char low, char high)
+{
+    __m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8(low));
+    return _mm_cmpeq_epi8(_mm_subs_epu8(offset, _mm_set1_epi8(char(high - low))),
+                          _mm_setzero_si128());
+}
+
+/**
+ * @brief idMask16 16 个字节中构成标识符的字符的位图
+ */
+inline quint32 idMask16(__m128i bytes)
+{
+    // 或上 0x20 后大写字母变为小写，其他字节不会因此落入 'a' 到 'z'
+    __m128i hit = _mm_or_si128(inRange16(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z'),
+                               inRange16(bytes, '0', '9'));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')));
+    return quint32(_mm_movemask_epi8(hit));
+}
+
+/**
+ * @brief whiteMask16 16 个字节中空白字符的位图
+ */
+inline quint32 whiteMask16(__m128i bytes)
+{
+    __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+                               _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t')));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r')));
+    return quint32(_mm_movemask_epi8(hit));
+}
+
+/**
+ * @brief specialMask16 16 个字节中带有 FlagSpecial 的字节的位图
+ */
+inline quint32 specialMask16(__m128i bytes)
+{
+    __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('#')),
+                               _mm_cmpeq_epi8(bytes, _mm_set1_epi8('/')));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(bytes, _mm_setzero_si128()));
+    // 非 ASCII 字节的最高位本身就是 movemask 取出的符号位
+    return whiteMask16(bytes) | quint32(_mm_movemask_epi8(hit))
+            | quint32(_mm_movemask_epi8(bytes));
+}
+
+const char *findSpecialSse2(const char *begin, const char *end)
+{
+    // 判断单个空格需要看下一字节，因此每次需要 17 个字节
+    for(; end - begin >= 17; begin += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        quint32 mask = specialMask16(bytes);
+        if(mask == 0) { continue; }
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin + 1));
+        quint32 lone = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '))))
+                & ~specialMask16(next);
+        mask &= ~lone;
+        if(mask != 0) { return begin + qCountTrailingZeroBits(mask); }
+    }
+    return findSpecialScalar(begin, end);
+}
+
+const char *skipWhiteSse2(const char *begin, const char *end)
+{
+    for(; end - begin >= 16; begin += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        quint32 mask = ~whiteMask16(bytes) & 0xFFFFu;
+        if(mask != 0) { return begin + qCountTrailingZeroBits(mask); }
+    }
+    return skipWhiteScalar(begin, end);
+}
+
+const char *findCommentEndSse2(const char *begin, const char *end)
+{
+    // 同时比较当前字节是否为 '*' 与下一字节是否为 '/'，因此每次需要 17 个字节
+    for(; end - begin >= 17; begin += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin + 1));
+        __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('*')),
+                                    _mm_cmpeq_epi8(next, _mm_set1_epi8('/')));
+        quint32 mask = quint32(_mm_movemask_epi8(hit));
+        if(mask != 0) { return begin + qCountTrailingZeroBits(mask); }
+    }
+    return findCommentEndScalar(begin, end);
+}
+
+const char *skipIdCharsSse2(const char *begin, const char *end)
+{
+    for(; end - begin >= 16; begin += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        quint32 mask = ~idMask16(bytes) & 0xFFFFu;
+        if(mask != 0) { return begin + qCountTrailingZeroBits(mask); }
+    }
+    return skipIdCharsScalar(begin, end);
+}
+
+const char *skipNumberCharsSse2(const char *begin, const char *end)
+{
+    for(; end - begin >= 16; begin += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        __m128i hit = _mm_or_si128(inRange16(bytes, '0', '9'),
+                                   _mm_cmpeq_epi8(bytes, _mm_set1_epi8('.')));
+        quint32 mask = ~quint32(_mm_movemask_epi8(hit)) & 0xFFFFu;
+        if(mask != 0) { return begin + qCountTrailingZeroBits(mask); }
+    }
+    return skipNumberCharsScalar(begin, end);
+}
+
+const char *findStringEndSse2(const char *begin, const char *end)
+{
+    for(; end - begin >= 16; begin += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')),
+                                   _mm_cmpeq_epi8(bytes, _mm_setzero_si128()));
+        quint32 mask = quint32(_mm_movemask_epi8(hit));
+        if(mask != 0) { return begin + qCountTrailingZeroBits(mask); }
+    }
+    return findStringEndScalar(begin, end);
+}
+
+#endif // BYTESCAN_SSE2
+
+#ifdef BYTESCAN_AVX2
+
+BYTESCAN_TARGET_AVX2 inline quint32 whiteMask32(__m256i bytes)
+{
+    __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+                                  _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\t')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\r')));
+    return quint32(_mm256_movemask_epi8(hit));
+}
+
+BYTESCAN_TARGET_AVX2 inline quint32 specialMask32(__m256i bytes)
+{
+    __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('#')),
+                                  _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('/')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(bytes, _mm256_setzero_si256()));
+    return whiteMask32(bytes) | quint32(_mm256_movemask_epi8(hit))
+            | quint32(_mm256_movemask_epi8(bytes));
+}
+
+BYTESCAN_TARGET_AVX2 const char *findSpecialAvx2(const char *begin, const char *end)
+{
+    for(; end - begin >= 33; begin += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+        quint32 mask = specialMask32(bytes);
+        if(mask == 0) { continue; }
+        __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin + 1));
+        quint32 lone = quint32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '))))
+                & ~specialMask32(next);
+        mask &= ~lone;
+        if(mask != 0) { return begin + qCountTrailingZeroBits(mask); }
+    }
+    return findSpecialSse2(begin, end);
+}
+
+BYTESCAN_TARGET_AVX2 const char *skipWhiteAvx2(const char *begin, const char *end)
+{
+    for(; end - begin >= 32; begin += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+        quint32 mask = ~whiteMask32(bytes);
+        if(mask != 0) { return begin + qCountTrailingZeroBits(mask); }
+    }
+    return skipWhiteSse2(begin, end);
+}
+
+BYTESCAN_TARGET_AVX2 const char *findCommentEndAvx2(const char *begin, const char *end)
+{
+    for(; end - begin >= 33; begin += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+        __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin + 1));
+        __m256i hit = _mm256_and_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('*')),
+                                       _mm256_cmpeq_epi8(next, _mm256_set1_epi8('/')));
+        quint32 mask = quint32(_mm256_movemask_epi8(hit));
+        if(mask != 0) { return begin + qCountTrailingZeroBits(mask); }
+    }
+    return findCommentEndSse2(begin, end);
+}
+
+BYTESCAN_TARGET_AVX2 inline __m256i inRange32(__m256i bytes, char low, char high)
+{
+    __m256i offset = _mm256_sub_epi8(bytes, _mm256_set1_epi8(low));
+    return _mm256_cmpeq_epi8(_mm256_subs_epu8(offset, _mm256_set1_epi8(char(high - low))),
+                             _mm256_setzero_si256());
+}
+
+BYTESCAN_TARGET_AVX2 const char *skipIdCharsAvx2(const char *begin, const char *end)
+{
+    for(; end - begin >= 32; begin += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+        __m256i hit = _mm256_or_si256(
+                    inRange32(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)), 'a', 'z'),
+                    inRange32(bytes, '0', '9'));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_')));
+        quint32 mask = ~quint32(_mm256_movemask_epi8(hit));
+        if(mask != 0) { return begin + qCountTrailingZeroBits(mask); }
+    }
+    return skipIdCharsSse2(begin, end);
+}
+
+BYTESCAN_TARGET_AVX2 const char *skipNumberCharsAvx2(const char *begin, const char *end)
+{
+    for(; end - begin >= 32; begin += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+        __m256i hit = _mm256_or_si256(inRange32(bytes, '0', '9'),
+                                      _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('.')));
+        quint32 mask = ~quint32(_mm256_movemask_epi8(hit));
+        if(mask != 0) { return begin + qCountTrailingZeroBits(mask); }
+    }
+    return skipNumberCharsSse2(begin, end);
+}
+
+BYTESCAN_TARGET_AVX2 const char *findStringEndAvx2(const char *begin, const char *end)
+{
+    for(; end - begin >= 32; begin += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')),
+                                      _mm256_cmpeq_epi8(bytes, _mm256_setzero_si256()));
+        quint32 mask = quint32(_mm256_movemask_epi8(hit));
+        if(mask != 0) { return begin + qCountTrailingZeroBits(mask); }
+    }
+    return findStringEndSse2(begin, end);
+}
+
+#endif // BYTESCAN_AVX2
+
+/**
+ * @brief selectKernels 按处理器支持的指令集与 LEXCORE_SIMD 选择实现
+ */
+Kernels selectKernels()
+{
+    QByteArray limit = qgetenv("LEXCORE_SIMD").toLower();
+#ifdef BYTESCAN_AVX2
+    if(limit != "scalar" && limit != "sse2" && __builtin_cpu_supports("avx2")) {
+        return Kernels{ LevelAvx2, findSpecialAvx2, skipWhiteAvx2, findCommentEndAvx2,
+                        skipIdCharsAvx2, skipNumberCharsAvx2, findStringEndAvx2 };
+    }
+#endif
+#ifdef BYTESCAN_SSE2
+    if(limit != "scalar") {
+        return Kernels{ LevelSse2, findSpecialSse2, skipWhiteSse2, findCommentEndSse2,
+                        skipIdCharsSse2, skipNumberCharsSse2, findStringEndSse2 };
+    }
+#endif
+    Q_UNUSED(limit)
+    return Kernels{ LevelScalar, findSpecialScalar, skipWhiteScalar, findCommentEndScalar,
+                    skipIdCharsScalar, skipNumberCharsScalar, findStringEndScalar };
+}
+
+} // namespace
+
+const Kernels &kernels()
+{
+    static const Kernels selected = selectKernels();
+    return selected;
+}
+
+const char *levelName()
+{
+    switch (level()) {
+    case LevelAvx2:
+        return "avx2";
+    case LevelSse2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+} // namespace ByteScan
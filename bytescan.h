@@ -0,0 +1,188 @@
+#ifndef BYTESCAN_H
+#define BYTESCAN_H
+
+#include <QtGlobal>
+
+/**
+ * @brief 字节批量扫描
+ * @details 预处理与词法分析中最热的循环都是“跳过一段同类字节，找到下一个需要处理的字节”，
+ *  这里的函数每次比较 16 或 32 个字节，由 movemask 得到比较结果的位图，
+ *  再用 ctz 直接定位第一个命中的字节
+ *  首次调用时按处理器支持的指令集选择 AVX2、SSE2 或逐字节实现，结果完全相同，
+ *  环境变量 LEXCORE_SIMD 设为 scalar 或 sse2 时可以限制使用的指令集，便于比对与测量
+ *  所有函数都不会读取 end 之后的字节
+ */
+namespace ByteScan {
+
+/**
+ * @brief 指令集级别
+ */
+enum Level {
+    LevelScalar = 0,    // 逐字节
+    LevelSse2,          // 每次 16 字节
+    LevelAvx2           // 每次 32 字节
+};
+
+/**
+ * @brief 字节类别标志
+ */
+enum ByteFlag : quint8 {
+    FlagSpecial = 0x01,     // 预处理需要处理的字节: '#' '/' '"' 空白 '\0' 与非 ASCII 字节
+    FlagWhite = 0x02,       // 空白字符
+    FlagId = 0x04,          // 构成标识符的字符: 字母、数字与下划线
+    FlagNumber = 0x08,      // 构成数字常量的字符: 数字与小数点
+};
+
+struct FlagTable {
+    quint8 value[256];
+};
+
+constexpr FlagTable makeFlagTable()
+{
+    FlagTable table = {};
+    const char whites[] = " \t\r\n";
+    for(int i = 0; whites[i] != 0; i++) { table.value[int(whites[i])] = FlagSpecial | FlagWhite; }
+    table.value[int('#')] = FlagSpecial;
+    table.value[int('/')] = FlagSpecial;
+    table.value[int('"')] = FlagSpecial;
+    table.value[0] = FlagSpecial;
+    for(int ch = 0x80; ch < 0x100; ch++) { table.value[ch] = FlagSpecial; }
+    for(int ch = 'a'; ch <= 'z'; ch++) { table.value[ch] = FlagId; }
+    for(int ch = 'A'; ch <= 'Z'; ch++) { table.value[ch] = FlagId; }
+    for(int ch = '0'; ch <= '9'; ch++) { table.value[ch] = FlagId | FlagNumber; }
+    table.value[int('_')] = FlagId;
+    table.value[int('.')] = FlagNumber;
+    return table;
+}
+
+constexpr FlagTable flagTable = makeFlagTable();
+
+/**
+ * @brief isLoneSpace 是否为无需预处理的单个空格
+ * @details 前后都是普通字节的单个空格在预处理结果中原样保留，可以与两侧的普通字节一起整段复制
+ *  调用者保证 text 之前的字节不是空白
+ * @param text 当前字节
+ * @param end 扫描结束位置
+ */
+inline bool isLoneSpace(const char *text, const char *end)
+{
+    return *text == ' ' && text + 1 < end && !(flagTable.value[uchar(text[1])] & FlagSpecial);
+}
+
+/**
+ * @brief 各扫描函数的一组实现
+ */
+struct Kernels {
+    Level level;
+    const char *(*findSpecial)(const char *begin, const char *end);     // begin 之前的字节不是空白
+    const char *(*skipWhite)(const char *begin, const char *end);
+    const char *(*findCommentEnd)(const char *begin, const char *end);
+    const char *(*skipIdChars)(const char *begin, const char *end);
+    const char *(*skipNumberChars)(const char *begin, const char *end);
+    const char *(*findStringEnd)(const char *begin, const char *end);
+};
+
+/**
+ * @brief kernels 当前处理器上使用的实现，首次调用时选择
+ */
+const Kernels & kernels();
+
+/**
+ * @brief level 当前使用的指令集级别
+ */
+inline Level level()
+{
+    return kernels().level;
+}
+
+/**
+ * @brief levelName 当前使用的指令集名称
+ */
+const char *levelName();
+
+/**
+ * @brief findSpecial 查找第一个预处理需要处理的字节
+ * @details 普通字节之间的单个空格视为普通字节，这样一整行代码通常只在注释、字符串处中断
+ * @param begin 扫描起始位置，该位置之前已输出的内容不以空格结尾时才能跳过其后的单个空格
+ * @param end 扫描结束位置
+ * @return 第一个需要处理的字节，没有时返回 end
+ */
+inline const char *findSpecial(const char *begin, const char *end)
+{
+    // 起始字节之前可能是已经输出的空格，不能按单个空格跳过
+    if(begin >= end || (flagTable.value[uchar(*begin)] & FlagSpecial)) { return begin; }
+    return kernels().findSpecial(begin + 1, end);
+}
+
+/**
+ * @brief skipWhite 跳过空白字符
+ * @param begin 扫描起始位置
+ * @param end 扫描结束位置
+ * @return 第一个非空白字节，没有时返回 end
+ */
+inline const char *skipWhite(const char *begin, const char *end)
+{
+    // 连续空白通常只有一两个字节，缩进较长时才交给向量实现
+    for(int i = 0; i < 4; i++, begin++) {
+        if(begin >= end || !(flagTable.value[uchar(*begin)] & FlagWhite)) { return begin; }
+    }
+    return kernels().skipWhite(begin, end);
+}
+
+/**
+ * @brief findCommentEnd 查找块注释的结束标志 "*" "/"
+ * @param begin 注释内容起始位置
+ * @param end 扫描结束位置
+ * @return 结束标志中 '*' 的位置，没有时返回 end
+ */
+inline const char *findCommentEnd(const char *begin, const char *end)
+{
+    return kernels().findCommentEnd(begin, end);
+}
+
+/**
+ * @brief skipIdChars 跳过构成标识符的字符
+ * @param begin 扫描起始位置
+ * @param end 扫描结束位置
+ * @return 第一个不属于标识符的字节，没有时返回 end
+ */
+inline const char *skipIdChars(const char *begin, const char *end)
+{
+    // 多数标识符不超过 8 个字节，先逐字节检查，较长时才交给向量实现
+    for(int i = 0; i < 8; i++, begin++) {
+        if(begin >= end || !(flagTable.value[uchar(*begin)] & FlagId)) { return begin; }
+    }
+    return kernels().skipIdChars(begin, end);
+}
+
+/**
+ * @brief skipNumberChars 跳过构成数字常量的字符
+ * @param begin 扫描起始位置
+ * @param end 扫描结束位置
+ * @return 第一个不是数字或小数点的字节，没有时返回 end
+ */
+inline const char *skipNumberChars(const char *begin, const char *end)
+{
+    for(int i = 0; i < 8; i++, begin++) {
+        if(begin >= end || !(flagTable.value[uchar(*begin)] & FlagNumber)) { return begin; }
+    }
+    return kernels().skipNumberChars(begin, end);
+}
+
+/**
+ * @brief findStringEnd 查找字符串常量的结束引号
+ * @param begin 字符串内容起始位置
+ * @param end 扫描结束位置
+ * @return 第一个 '"' 或 '\0'，没有时返回 end
+ */
+inline const char *findStringEnd(const char *begin, const char *end)
+{
+    for(int i = 0; i < 8; i++, begin++) {
+        if(begin >= end || *begin == '"' || *begin == 0) { return begin; }
+    }
+    return kernels().findStringEnd(begin, end);
+}
+
+} // namespace ByteScan
+
+#endif // BYTESCAN_H
@@ -0,0 +1,138 @@
+#include "constantpool.h"
+
+#include <charconv>
+#include <cstring>
+
+#include <QLocale>
+
+ConstantPool::ConstantPool() {}
+
+void ConstantPool::clear()
+{
+    types.clear();
+    values.clear();
+    lengths.clear();
+    stringArena.truncate(0);
+    integerIndex.clear();
+    floatIndex.clear();
+    stringIndex.clear();
+}
+
+int ConstantPool::addInteger(qint64 value)
+{
+    auto iter = integerIndex.constFind(value);
+    if(iter != integerIndex.constEnd()) { return iter.value(); }
+    int index = append(Type::INTEGER, quint64(value), 0);
+    integerIndex.insert(value, index);
+    return index;
+}
+
+int ConstantPool::addFloat(double value)
+{
+    quint64 bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    auto iter = floatIndex.constFind(bits);
+    if(iter != floatIndex.constEnd()) { return iter.value(); }
+    int index = append(Type::FLOAT, bits, 0);
+    floatIndex.insert(bits, index);
+    return index;
+}
+
+int ConstantPool::addString(const char *text, int length)
+{
+    auto iter = stringIndex.constFind(QByteArray::fromRawData(text, length));
+    if(iter != stringIndex.constEnd()) { return iter.value(); }
+    int index = append(Type::STRING, quint64(stringArena.size()), quint32(length));
+    stringArena.append(text, length);
+    stringIndex.insert(QByteArray(text, length), index);
+    return index;
+}
+
+int ConstantPool::addFrom(const ConstantPool &other, int i)
+{
+    switch (other.type(i)) {
+    case Type::INTEGER:
+        return addInteger(other.integer(i));
+    case Type::FLOAT:
+        return addFloat(other.floating(i));
+    default:
+        return addString(other.stringArena.constData() + other.values.at(i), int(other.lengths.at(i)));
+    }
+}
+
+int ConstantPool::size() const
+{
+    return types.size();
+}
+
+ConstantPool::Type ConstantPool::type(int i) const
+{
+    return Type(types.at(i));
+}
+
+qint64 ConstantPool::integer(int i) const
+{
+    return qint64(values.at(i));
+}
+
+double ConstantPool::floating(int i) const
+{
+    quint64 bits = values.at(i);
+    double value = 0;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+QString ConstantPool::string(int i) const
+{
+    return QString::fromUtf8(stringArena.constData() + values.at(i), int(lengths.at(i)));
+}
+
+QString ConstantPool::text(int i) const
+{
+    switch (type(i)) {
+    case Type::INTEGER:
+        return QString::number(integer(i));
+    case Type::FLOAT:
+        return QString::number(floating(i), 'g', QLocale::FloatingPointShortest);
+    default:
+        return string(i);
+    }
+}
+
+bool ConstantPool::parseInteger(const char *text, int length, qint64 &value)
+{
+    long long result = 0;
+    std::from_chars_result parsed = std::from_chars(text, text + length, result);
+    if(parsed.ec != std::errc() || parsed.ptr != text + length) { return false; }
+    value = result;
+    return true;
+}
+
+bool ConstantPool::parseFloat(const char *text, int length, double &value)
+{
+    // 只接受 "数字.数字" 形式，小数点后可以没有数字
+    int dot = 0;
+    while(dot < length && text[dot] >= '0' && text[dot] <= '9') { dot++; }
+    if(dot == 0 || dot >= length || text[dot] != '.') { return false; }
+    for(int i = dot + 1; i < length; i++) {
+        if(text[i] < '0' || text[i] > '9') { return false; }
+    }
+#if defined(__cpp_lib_to_chars)
+    std::from_chars_result parsed = std::from_chars(text, text + length, value);
+    return parsed.ec == std::errc() && parsed.ptr == text + length;
+#else
+    // 标准库缺少浮点数 from_chars 时退回与区域设置无关的 QByteArray::toDouble
+    bool ok = false;
+    value = QByteArray::fromRawData(text, length).toDouble(&ok);
+    return ok;
+#endif
+}
+
+int ConstantPool::append(Type type, quint64 value, quint32 length)
+{
+    types.append(quint8(type));
+    values.append(value);
+    lengths.append(length);
+    return types.size() - 1;
+}
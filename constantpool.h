@@ -0,0 +1,93 @@
+#ifndef CONSTANTPOOL_H
+#define CONSTANTPOOL_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include "tokenbuffer.h"
+
+/**
+ * @brief 常量池
+ * @details 整数与浮点数在词法分析时即解析为 qint64 与 double，字符串保存 UTF-8 字节
+ *  相同类型且值相等的常量只登记一次，编号按首次出现的顺序分配
+ */
+class ConstantPool
+{
+public:
+    using Type = TokenBuffer::Kind;
+
+    ConstantPool();
+
+    void clear();
+
+    /**
+     * @brief addInteger 登记整数常量
+     * @param value 整数值
+     * @return 常量编号
+     */
+    int addInteger(qint64 value);
+    /**
+     * @brief addFloat 登记浮点数常量
+     * @param value 浮点数值
+     * @return 常量编号
+     */
+    int addFloat(double value);
+    /**
+     * @brief addString 登记字符串常量
+     * @param text 字符串内容起始指针(不含引号)
+     * @param length 字符串字节数
+     * @return 常量编号
+     */
+    int addString(const char *text, int length);
+    /**
+     * @brief addFrom 登记另一常量池中的常量，用于合并分块识别的结果
+     * @param other 另一常量池
+     * @param i 常量在另一常量池中的编号
+     * @return 常量在本常量池中的编号
+     */
+    int addFrom(const ConstantPool & other, int i);
+
+    int size() const;
+    Type type(int i) const;
+    qint64 integer(int i) const;
+    double floating(int i) const;
+    QString string(int i) const;
+    /**
+     * @brief text 获取常量的显示文本
+     * @param i 常量编号
+     * @return 整数与浮点数为最短十进制表示，字符串为其内容
+     */
+    QString text(int i) const;
+
+    /**
+     * @brief parseInteger 解析十进制整数
+     * @param text 数字起始指针
+     * @param length 数字字节数
+     * @param value 带出整数值
+     * @return 是否为合法且不溢出的整数
+     */
+    static bool parseInteger(const char *text, int length, qint64 & value);
+    /**
+     * @brief parseFloat 解析 "数字.数字" 形式的浮点数
+     * @param text 数字起始指针
+     * @param length 数字字节数
+     * @param value 带出浮点数值
+     * @return 是否为合法浮点数，含有多个小数点时不合法
+     */
+    static bool parseFloat(const char *text, int length, double & value);
+
+private:
+    QVector<quint8> types;      // 常量类型
+    QVector<quint64> values;    // 整数值、浮点数位模式或字符串在缓冲区中的位置
+    QVector<quint32> lengths;   // 字符串字节数
+    QByteArray stringArena;     // 所有字符串常量的字节
+    QHash<qint64, int> integerIndex;    // 整数值到编号的映射
+    QHash<quint64, int> floatIndex;     // 浮点数位模式到编号的映射
+    QHash<QByteArray, int> stringIndex; // 字符串内容到编号的映射
+
+    int append(Type type, quint64 value, quint32 length);
+};
+
+#endif // CONSTANTPOOL_H
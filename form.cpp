@@ -76,12 +76,11 @@ void Form::setConstantHeader()
 
 void Form::fillIdTable()
 {
-    setTableScale(ui->symbolTable, 1, util->getIdNum());
+    const SymbolTable & identifiers = util->getIdentifiers();
+    setTableScale(ui->symbolTable, 1, identifiers.size());
     setIdHeader();
-    auto iter = util->getIdBegin();
-    for(int i = 0; i < util->getIdNum(); i++, iter++) {
-        QString name = iter->getValue();
-        QTableWidgetItem * item = new QTableWidgetItem(name);
+    for(int i = 0; i < identifiers.size(); i++) {
+        QTableWidgetItem * item = new QTableWidgetItem(identifiers.text(i));
         setFontPlat(item, 10, false);
         ui->symbolTable->setItem(i, 0, item);
     }
@@ -89,15 +88,15 @@ void Form::fillIdTable()
 
 void Form::fillConstantTable()
 {
-    setTableScale(ui->constantTable, 2, util->getConstantNum());
+    const ConstantPool & constants = util->getConstants();
+    setTableScale(ui->constantTable, 2, constants.size());
     setConstantHeader();
-    auto iter = util->getConstantBegin();
-    for(int i = 0; i < util->getConstantNum(); i++, iter++) {
-        QTableWidgetItem * item = new QTableWidgetItem(iter->getValue());
+    for(int i = 0; i < constants.size(); i++) {
+        QTableWidgetItem * item = new QTableWidgetItem(constants.text(i));
         setFontPlat(item, 10, false);
         ui->constantTable->setItem(i, 0, item);
         QString name;
-        switch (iter->getType()) {
+        switch (constants.type(i)) {
         case LexAnalyzer::SymbolItem::Type::INTEGER: name = "integer"; break;
         case LexAnalyzer::SymbolItem::Type::FLOAT: name = "float"; break;
         case LexAnalyzer::SymbolItem::Type::STRING: name = "string"; break;
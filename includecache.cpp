@@ -0,0 +1,37 @@
+#include "includecache.h"
+
+IncludeCache::IncludeCache() {}
+
+QSharedPointer<const PreProcessUnit> IncludeCache::find(const QString &path, const QDateTime &modified,
+                                                        qint64 size) const
+{
+    QMutexLocker locker(&mutex);
+    auto iter = entries.constFind(path);
+    if(iter == entries.constEnd() || iter.value().modified != modified || iter.value().size != size) {
+        return QSharedPointer<const PreProcessUnit>();
+    }
+    return iter.value().unit;
+}
+
+void IncludeCache::insert(const QString &path, const QDateTime &modified, qint64 size,
+                          const QSharedPointer<const PreProcessUnit> &unit)
+{
+    CacheEntry entry;
+    entry.modified = modified;
+    entry.size = size;
+    entry.unit = unit;
+    QMutexLocker locker(&mutex);
+    entries.insert(path, entry);
+}
+
+void IncludeCache::clear()
+{
+    QMutexLocker locker(&mutex);
+    entries.clear();
+}
+
+int IncludeCache::size() const
+{
+    QMutexLocker locker(&mutex);
+    return entries.size();
+}
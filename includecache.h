@@ -0,0 +1,94 @@
+#ifndef INCLUDECACHE_H
+#define INCLUDECACHE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief 宏定义记录
+ * @details offset 为指令在输出中的位置，宏定义自该位置起生效
+ */
+struct MacroDefine {
+    qsizetype offset = 0;
+    QByteArray symbol;
+    QByteArray target;
+};
+
+/**
+ * @brief 包含指令记录
+ * @details offset 为指令在输出中的位置，defineCount 为指令之前出现的宏定义数量
+ */
+struct IncludeDirective {
+    qsizetype offset = 0;
+    int defineCount = 0;
+    QString filename;
+};
+
+/**
+ * @brief 单个文件的预处理识别结果
+ * @details 只保存与包含上下文无关的内容，包含指令仅记录位置与文件名，
+ *  在拼接翻译单元时才展开，因此同一头文件的识别结果可以被多次复用
+ */
+struct PreProcessUnit {
+    QByteArray text;                    // 删除注释与多余空白后的文本
+    QVector<MacroDefine> defines;       // 文件中的宏定义
+    QVector<IncludeDirective> includes; // 文件中的包含指令
+};
+
+/**
+ * @brief 包含文件缓存
+ * @details 以规范化路径为键保存头文件的识别结果，
+ *  文件修改时间或大小变化后缓存失效，需要重新识别，
+ *  各接口可以被多个线程同时调用
+ */
+class IncludeCache
+{
+public:
+    IncludeCache();
+
+    /**
+     * @brief find 查找仍然有效的缓存
+     * @param path 规范化文件路径
+     * @param modified 文件当前修改时间
+     * @param size 文件当前字节数
+     * @return 识别结果，未命中时为空
+     */
+    QSharedPointer<const PreProcessUnit> find(const QString & path, const QDateTime & modified,
+                                              qint64 size) const;
+
+    /**
+     * @brief insert 保存文件的识别结果
+     * @param path 规范化文件路径
+     * @param modified 识别时的文件修改时间
+     * @param size 识别时的文件字节数
+     * @param unit 识别结果
+     */
+    void insert(const QString & path, const QDateTime & modified, qint64 size,
+                const QSharedPointer<const PreProcessUnit> & unit);
+
+    /**
+     * @brief clear 清空缓存
+     */
+    void clear();
+
+    int size() const;
+
+private:
+    Q_DISABLE_COPY(IncludeCache)
+
+    struct CacheEntry {
+        QDateTime modified;
+        qint64 size = 0;
+        QSharedPointer<const PreProcessUnit> unit;
+    };
+
+    QHash<QString, CacheEntry> entries;  // 规范化路径到缓存项的映射
+    mutable QMutex mutex;   // 保护缓存表
+};
+
+#endif // INCLUDECACHE_H
@@ -1,5 +1,41 @@
 #include "lexanalyzer.h"
 
+#include <cstring>
+#include <utility>
+
+#include <QThread>
+#include <QThreadPool>
+
+#include "bytescan.h"
+#include "spscring.h"
+
+namespace {
+
+/**
+ * @brief countQuotes 统计区间内双引号的数量
+ */
+qsizetype countQuotes(const char *begin, const char *end)
+{
+    qsizetype count = 0;
+    while(begin < end) {
+        const void *quote = memchr(begin, '"', size_t(end - begin));
+        if(quote == nullptr) { break; }
+        begin = static_cast<const char *>(quote) + 1;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief isTableReference 该类型的 Token 是否引用标识符表或常量表
+ */
+bool isTableReference(TokenBuffer::Kind kind)
+{
+    return kind != TokenBuffer::Kind::KEYWORD && kind != TokenBuffer::Kind::OPERATOR;
+}
+
+} // namespace
+
 LexAnalyzer::LexAnalyzer()
 {
     preServer = new PreProcess();
@@ -12,404 +48,847 @@ LexAnalyzer::~LexAnalyzer()
     }
 }
 
-const QString &LexAnalyzer::getSrc() const
+const QByteArray &LexAnalyzer::getSrc() const
 {
     return src;
 }
 
-void LexAnalyzer::setSrc(const QString &newSrc)
+void LexAnalyzer::setSrc(const QByteArray &newSrc)
 {
+    setInput(nullptr);
     src = newSrc;
+    isLexComplete = false;
+    lastPatch = TokenPatch();
+}
+
+void LexAnalyzer::setSrc(const QString &newSrc)
+{
+    setInput(nullptr);
+    src = newSrc.toUtf8();
+    isLexComplete = false;
+    lastPatch = TokenPatch();
+}
+
+void LexAnalyzer::setInput(QIODevice *device)
+{
+    if(device != &inputFile) { inputFile.close(); }
+    // 切换到或离开流式输入时源码随之改变，之前的结果不能再作为增量分析的基础
+    if(device != nullptr || input != nullptr) {
+        isLexComplete = false;
+        lastPatch = TokenPatch();
+    }
+    input = device;
+    window.clear();
+    if(device != nullptr) { src.clear(); }
+}
+
+bool LexAnalyzer::setInput(int fd)
+{
+    setInput(nullptr);
+    if(!inputFile.open(fd, QIODevice::ReadOnly)) {
+        errorMsg = "无法打开输入: " + inputFile.errorString();
+        return false;
+    }
+    setInput(&inputFile);
+    return true;
+}
+
+void LexAnalyzer::setWindowSize(int bytes)
+{
+    windowSize = qMax(bytes, 1);
 }
 
 void LexAnalyzer::initUtil()
 {
    resetResult();
-   lexBegin = lexForward = 0;
-   scanBufferA.resize(BufferLength + 1, 1);
-   scanBufferB.resize(BufferLength + 1, 1);
-   scanBufferA[BufferLength] = 0;
-   scanBufferB[BufferLength] = 0;
-   initReserveMap();
+   // 扫描直接在源码上进行，QByteArray 保证 src[size] 为 '\0'
+   // 流式输入与同步预处理时窗口初始为空，第一次读取即装载数据
+   window.truncate(0);
+   bool useWindow = input != nullptr || isFeeding;
+   windowBase = useWindow ? window.constData() : src.constData();
+   scanLimit = windowBase + (useWindow ? window.size() : src.size());
+   scanCursor = lexBegin = windowBase;
+   scanStop = nullptr;
+   resumeState = LexTable::StateStart;
+   windowOffset = 0;
+   progressMark = ProgressStep;
 }
 
-void LexAnalyzer::initReserveMap()
+bool LexAnalyzer::mainAnalyzer()
 {
-    if(keywordMap.isEmpty()) {
-        for(int i = 0; i < keywordNum; i++) {
-            keywordMap.insert(keywordList.at(i), i);
+    // 上一块数据末尾未识别完的词法单元从保存的状态继续识别
+    quint8 state = resumeState;
+    resumeState = LexTable::StateStart;
+    isWindowEnd = false;
+    while(state == LexTable::StateStart) {
+        // 初始状态下读入的只有空白字符
+        lexBegin = scanCursor;
+        state = LexTable::transition.next[state][LexTable::charClass.value[uchar(getNextChar())]];
+    }
+    // 标识符、数字与字符串中不改变状态的字节批量跳过，之后读入的字节使词法单元结束或需要补充窗口
+    if(state == LexTable::StateId) {
+        scanCursor = ByteScan::skipIdChars(scanCursor, scanLimit);
+    } else if(state == LexTable::StateNumber) {
+        scanCursor = ByteScan::skipNumberChars(scanCursor, scanLimit);
+    } else if(state == LexTable::StateString) {
+        scanCursor = ByteScan::findStringEnd(scanCursor, scanLimit);
+    }
+    while(!LexTable::isFinal(state)) {
+        char ch = getNextChar();
+        if(ch == 0 && isWindowEnd && isFeeding) {
+            // 词法单元可能延续到下一块数据中，保存状态，送入数据后从窗口末尾继续识别
+            resumeState = state;
+            return false;
         }
+        state = LexTable::transition.next[state][LexTable::charClass.value[uchar(ch)]];
+    }
+    if(scanStop != nullptr && lexBegin >= scanStop) {
+        // 分块识别时起始于块末尾之后的词法单元留给下一块
+        return false;
+    }
+    if(isWindowEnd && isFeeding) {
+        // 窗口在两个词法单元之间结束，等待下一块数据
+        return false;
+    }
+    switch (state) {
+    case LexTable::AcceptEnd:
+        // Stop resolving any word when EOF has been received
+        return false;
+    case LexTable::ErrorChar:
+        throw QString("无法识别的字符");
+    case LexTable::ErrorString:
+        throw QString("字符串缺少结束引号");
+    case LexTable::AcceptIdBack:
+    case LexTable::AcceptNumberBack:
+    case LexTable::AcceptOperatorBack:
+        scanBackspace();
+        break;
+    default:
+        break;
+    }
+    qsizetype offset = windowOffset + (lexBegin - windowBase);
+    int length = int(scanCursor - lexBegin);
+    if(tokenBatch != nullptr) {
+        // 流水线模式下只记录词法单元，查表与登记由登记线程完成
+        tokenBatch->append(state, offset, lexBegin, length);
+    } else {
+        acceptToken(state, lexBegin, length, offset);
     }
+    return true;
 }
 
-bool LexAnalyzer::mainAnalyzer()
+void LexAnalyzer::acceptToken(quint8 state, const char *text, int length, qsizetype offset)
 {
-    QString str;
-    QChar ch =  getNextChar().toLatin1();
-    // Stop resolving any word when EOF has been received
-    if(ch == 0) { return false; }
-    // jump over any whitespace
-    while(ch == ' ') { ch = getNextChar().toLatin1(); }
-    if(isLetter(ch)) {
-        symbolRecogHandler(ch, str);
-        return true;
-    }
-    if(isNumber(ch)) {
-        numberRecogHandler(ch, str);
-        return true;
-    }
-    if(ch == '"') {
-        stringRecogHandler(ch, str);
-        return true;
-    }
-    if(operatorRecogHandler(ch, str)) {
-        return true;
-    } else {
-        throw QString("无法识别的字符");
+    switch (state) {
+    case LexTable::AcceptIdBack: {
+        LexTable::Keyword keyword = LexTable::findKeyword(text, length);
+        if(keyword != LexTable::KwNone) {
+            generateSymbolFlag(SymbolItem::Type::KEYWORD, keyword, offset, length);
+        } else {
+            generateSymbolFlag(SymbolItem::Type::ID, identifierTable.intern(text, length), offset, length);
+        }
+        break;
+    }
+    case LexTable::AcceptNumberBack:
+        // 数字在识别时即解析为数值，常量表中不再保存文本
+        if(memchr(text, '.', size_t(length)) != nullptr) {
+            double value = 0;
+            if(!ConstantPool::parseFloat(text, length, value)) { throw QString("非法的浮点数常量"); }
+            generateSymbolFlag(SymbolItem::Type::FLOAT, constantPool.addFloat(value), offset, length);
+        } else {
+            qint64 value = 0;
+            if(!ConstantPool::parseInteger(text, length, value)) { throw QString("整数常量超出范围"); }
+            generateSymbolFlag(SymbolItem::Type::INTEGER, constantPool.addInteger(value), offset, length);
+        }
+        break;
+    case LexTable::AcceptString:
+        // 去掉两侧引号
+        generateSymbolFlag(SymbolItem::Type::STRING, constantPool.addString(text + 1, length - 2),
+                           offset, length);
+        break;
+    default:
+        generateSymbolFlag(SymbolItem::Type::OPERATOR, LexTable::findOperator(text, length), offset, length);
+        break;
     }
 }
 
 void LexAnalyzer::resetResult()
 {
-    identifierList.clear();
-    constantList.clear();
-    symbolAnalyList.clear();
-    isReady = true;
-    isBufferA = false;
+    identifierTable.clear();
+    constantPool.clear();
+    tokenList.clear();
     isFileEnd = false;
-    isBackEngaged = false;
+    isLexComplete = false;
 }
 
-void LexAnalyzer::engageBuffer(bool isLeftBuffer)
+bool LexAnalyzer::refillWindow()
 {
-    if(isFileEnd) {return;}
-    if(isBackEngaged) {isBackEngaged = false; return; }
-    bool lessSrc = false;
-    int engageLength = 0;
-    if(src.length() < BufferLength) {
-        lessSrc = true;
-        isFileEnd = true;
-        engageLength = src.length();
-    } else { engageLength = BufferLength; }
-
-    if(isLeftBuffer) {
-        if(lessSrc) {
-            replaceBufferChar(scanBufferA, src.length(), src);
-            scanBufferA[src.length()] = 0;
-        } else { replaceBufferChar(scanBufferA, BufferLength, src); }
-    } else {
-        if(lessSrc) {
-            replaceBufferChar(scanBufferB, src.length(), src);
-            scanBufferB[src.length()] = 0;
-        } else { replaceBufferChar(scanBufferB, BufferLength, src); }
+    if(input == nullptr) { return false; }
+    qsizetype keep = compactWindow();
+    window.resize(keep + windowSize);
+    qint64 count = input->read(window.data() + keep, windowSize);
+    // 管道等顺序设备暂时没有数据时等待，到达结尾时 waitForReadyRead 返回 false
+    while(count == 0 && input->isSequential() && input->waitForReadyRead(-1)) {
+        count = input->read(window.data() + keep, windowSize);
     }
-    src.remove(0, engageLength);
-    return;
+    // resize 后 window[size] 仍为 '\0'，作为新窗口的哨兵
+    window.resize(keep + qsizetype(qMax<qint64>(count, 0)));
+    rebaseWindow(keep);
+    if(count < 0) {
+        throw QString("读取输入失败: ") + input->errorString();
+    }
+    return count > 0;
+}
+
+qsizetype LexAnalyzer::compactWindow()
+{
+    // 保留正在识别的词法单元，丢弃之前已经识别完的字节
+    qsizetype drop = lexBegin - windowBase;
+    qsizetype keep = scanLimit - lexBegin;
+    if(drop > 0) {
+        memmove(window.data(), window.constData() + drop, size_t(keep));
+        window.resize(keep);
+    }
+    windowOffset += drop;
+    return keep;
+}
+
+void LexAnalyzer::rebaseWindow(qsizetype cursor)
+{
+    // 流式输入的总长度事先未知，窗口延伸到 Token 表无法记录的位置时报错，而不是截断位置
+    if(windowOffset + window.size() > TokenBuffer::MaxSourceSize) {
+        throw QString("输入超过 4GB，无法记录词法单元位置");
+    }
+    windowBase = window.constData();
+    lexBegin = windowBase;
+    scanCursor = windowBase + cursor;
+    scanLimit = windowBase + window.size();
+}
+
+void LexAnalyzer::feedWindow(const char *data, qsizetype length)
+{
+    qsizetype keep = compactWindow();
+    window.resize(keep + length);
+    memcpy(window.data() + keep, data, size_t(length));
+    // 未识别完的词法单元已经扫描到原窗口末尾，从新送入的第一个字节继续
+    rebaseWindow(keep);
+    while(mainAnalyzer()) {}
 }
 
-void LexAnalyzer::replaceBufferChar(QString &buffer, int length, QString &src)
+bool LexAnalyzer::finishFeed(bool isPreProcessed)
 {
-    if(length > BufferLength) { return; }
-    for(int i = 0; i < length; i++) {
-        buffer[i] = src[i];
+    isFeeding = false;
+    if(!isPreProcessed) {
+        errorMsg = preServer->getErrMsg();
+        return false;
+    }
+    try {
+        while(mainAnalyzer()) {}
+    }  catch (QString e) {
+        errorMsg = e;
+        return false;
     }
+    return true;
 }
 
-QChar LexAnalyzer::getNextChar()
+void LexAnalyzer::checkSourceSize() const
 {
-    if(isBufferA && scanBufferA[lexForward] == 0) {return 0;}
-    if(!isBufferA && scanBufferB[lexForward] == 0) {return 0;}
-    if(lexForward + 1 >= BufferLength || isReady) {
-        isReady = false;
-        lexForward = 0;
-        engageBuffer(!isBufferA);
-        isBufferA = !isBufferA;
-        return (isBufferA) ? scanBufferA[lexForward] : scanBufferB[lexForward];
+    if(input == nullptr && !isFeeding && src.size() > TokenBuffer::MaxSourceSize) {
+        throw QString("源码超过 4GB，无法记录词法单元位置");
     }
-    else {
-        return (isBufferA) ? scanBufferA[++lexForward] : scanBufferB[++lexForward];
+}
+
+char LexAnalyzer::getNextChar()
+{
+    char ch = *scanCursor;
+    if(ch == 0 && scanCursor == scanLimit) {
+        if(isFileEnd || !refillWindow()) {
+            // 停留在哨兵上，之后的读取都得到 '\0'
+            isWindowEnd = true;
+            isFileEnd = !isFeeding;
+            return 0;
+        }
+        ch = *scanCursor;
     }
+    scanCursor++;
+    return ch;
 }
 
 void LexAnalyzer::scanBackspace()
 {
-    if(lexForward == 0) {
-        isBackEngaged = true;
-        isBufferA = !isBufferA;
-        lexForward = BufferLength - 1;
-    } else {
-        lexForward--;
+    // 窗口末尾读入的哨兵没有前移扫描位置
+    if(!isWindowEnd) {
+        scanCursor--;
     }
 }
 
-int LexAnalyzer::findKeyword(QString &target)
+void LexAnalyzer::sendSymbolMsg(const QString &symbol)
 {
-    auto mapIter = keywordMap.find(target);
-    if(mapIter == keywordMap.end()) {
-        return -1;
-    } else {
-        return mapIter.value();
+    this->symbolMsg = symbol;
+}
+
+void LexAnalyzer::generateSymbolFlag(SymbolItem::Type type, int index, qsizetype offset, int length)
+{
+    tokenList.append(type, offset, length, index);
+}
+
+bool LexAnalyzer::startPreProcess()
+{
+    // 预处理结果作为内存中的源码，不再使用流式输入
+    setInput(nullptr);
+    isLexComplete = false;
+    lastPatch = TokenPatch();
+    if(!preServer->start(src)) {
+        errorMsg = preServer->getErrMsg();
+        return false;
+    }
+    return true;
+}
+
+bool LexAnalyzer::startPreProcess(const SourceFile &file)
+{
+    setInput(nullptr);
+    isLexComplete = false;
+    lastPatch = TokenPatch();
+    if(!preServer->start(file, src)) {
+        errorMsg = preServer->getErrMsg();
+        return false;
     }
+    return true;
 }
 
-int LexAnalyzer::findOperator(QString target)
+void LexAnalyzer::setIncludeDir(const QString &dir)
 {
-    return operatorList.indexOf(target);
+    preServer->setIncludeDir(dir);
 }
 
-void LexAnalyzer::pushId(QString &id)
+void LexAnalyzer::setIncludeCache(const QSharedPointer<IncludeCache> &cache)
 {
-    SymbolItem item = SymbolItem(id, SymbolItem::Type::ID);
-    identifierList.push_back(item);
+    preServer->setIncludeCache(cache);
 }
 
-void LexAnalyzer::pushConstant(QString &constant, SymbolItem::Type type)
+void LexAnalyzer::setProgressHandler(const ProgressHandler &handler)
 {
-    SymbolItem item = SymbolItem(constant, type);
-    constantList.push_back(item);
+    progressHandler = handler;
+    preServer->setProgressHandler(handler);
 }
 
-void LexAnalyzer::symbolRecogHandler(QChar &ch, QString & str)
+void LexAnalyzer::reportProgress()
 {
-    while(isIdChar(ch)) {
-        str.push_back(ch);
-        ch = getNextChar();
+    qsizetype done = windowOffset + (scanCursor - windowBase);
+    progressMark = done + ProgressStep;
+    if(!progressHandler(done, input == nullptr ? src.size() : -1)) {
+        throw QString("分析已取消");
     }
-    scanBackspace();
-    int index = findKeyword(str);
-    if(index != -1) {
-        generateSymbolFlag(keywordList[index], SymbolItem::Type::KEYWORD);
-    } else {
-        generateSymbolFlag(str, SymbolItem::Type::ID);
-        pushId(str);
+}
+
+bool LexAnalyzer::startParallelLexAnalyze(int threadCount)
+{
+    int count = threadCount > 0 ? threadCount : QThread::idealThreadCount();
+    count = int(qMin<qsizetype>(count, src.size() / MinChunkLength));
+    initUtil();
+    // 源码过大时由顺序分析报告错误
+    if(count <= 1 || src.size() > TokenBuffer::MaxSourceSize) { return startLexAnalyze(); }
+
+    QVector<qsizetype> bounds = splitChunks(count);
+    count = bounds.size() - 1;
+    QVector<LexAnalyzer *> chunks;
+    QThreadPool pool;
+    pool.setMaxThreadCount(count);
+    for(int k = 0; k < count; k++) {
+        // 各块共享同一份源码，只是扫描区间不同
+        LexAnalyzer *chunk = new LexAnalyzer();
+        chunk->setSrc(src);
+        chunk->initUtil();
+        chunk->scanCursor = chunk->windowBase + bounds.at(k);
+        chunk->scanStop = (k + 1 < count) ? chunk->windowBase + bounds.at(k + 1) : nullptr;
+        chunks.append(chunk);
+        pool.start([chunk]() { chunk->lexChunk(); });
+    }
+    pool.waitForDone();
+
+    // 按块的顺序把块内首次出现的标识符与常量依次登记，编号与顺序识别时相同
+    QVector<QVector<int>> idMaps;
+    QVector<QVector<int>> constantMaps;
+    for(const LexAnalyzer * chunk : std::as_const(chunks)) {
+        QVector<int> idMap(chunk->identifierTable.size());
+        for(int id = 0; id < idMap.size(); id++) {
+            idMap[id] = identifierTable.intern(chunk->identifierTable.data(id),
+                                               chunk->identifierTable.length(id));
+        }
+        QVector<int> constantMap(chunk->constantPool.size());
+        for(int i = 0; i < constantMap.size(); i++) {
+            constantMap[i] = constantPool.addFrom(chunk->constantPool, i);
+        }
+        idMaps.append(idMap);
+        constantMaps.append(constantMap);
+        // 出错或遇到 '\0' 时顺序识别不会继续，之后的块全部丢弃
+        if(!chunk->errorMsg.isEmpty() || chunk->isFileEnd) { break; }
+    }
+    int used = idMaps.size();
+    for(int k = 0; k < used; k++) {
+        LexAnalyzer *chunk = chunks.at(k);
+        const QVector<int> & idMap = idMaps.at(k);
+        const QVector<int> & constantMap = constantMaps.at(k);
+        pool.start([chunk, &idMap, &constantMap]() { chunk->remapTokens(idMap, constantMap); });
+    }
+    pool.waitForDone();
+    for(int k = 0; k < used; k++) {
+        tokenList.append(chunks.at(k)->tokenList);
     }
-    str.clear();
+    QString chunkError = chunks.at(used - 1)->errorMsg;
+    qDeleteAll(chunks);
+
+    if(!chunkError.isEmpty()) {
+        errorMsg = chunkError;
+        return false;
+    }
+    scanCursor = scanLimit;
+    isFileEnd = true;
+    isLexComplete = true;
+    return true;
 }
 
-void LexAnalyzer::numberRecogHandler(QChar &ch, QString &str)
+QVector<qsizetype> LexAnalyzer::splitChunks(int count) const
 {
-    while (isNumber(ch) || ch =='.') {
-        str.push_back(ch);
-        ch = getNextChar();
+    const char *data = src.constData();
+    qsizetype size = src.size();
+    QVector<qsizetype> nominal(count + 1);
+    for(int k = 0; k <= count; k++) { nominal[k] = size * k / count; }
+
+    QVector<qsizetype> quotes(count);
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount(count);
+        qsizetype *counts = quotes.data();
+        for(int k = 0; k < count; k++) {
+            const char *begin = data + nominal.at(k);
+            const char *end = data + nominal.at(k + 1);
+            pool.start([counts, k, begin, end]() { counts[k] = countQuotes(begin, end); });
+        }
+        pool.waitForDone();
     }
-    scanBackspace();
-    if(str.contains('.')) {
-        generateSymbolFlag(str, SymbolItem::Type::FLOAT);
-        pushConstant(str, SymbolItem::Type::FLOAT);
-    } else {
-        generateSymbolFlag(str, SymbolItem::Type::INTEGER);
-        pushConstant(str, SymbolItem::Type::INTEGER);
+
+    QVector<qsizetype> bounds;
+    bounds.append(0);
+    bool inString = false;
+    for(int k = 1; k < count; k++) {
+        // 之前的引号数为奇数时分割点位于字符串中，向后找到字符串之外的第一个空格
+        inString = inString != bool(quotes.at(k - 1) & 1);
+        bool quoted = inString;
+        qsizetype pos = nominal.at(k);
+        while(pos < size && (quoted || data[pos] != ' ')) {
+            if(data[pos] == '"') { quoted = !quoted; }
+            pos++;
+        }
+        if(pos > bounds.last() && pos < size) { bounds.append(pos); }
     }
-    str.clear();
+    bounds.append(size);
+    return bounds;
 }
 
-void LexAnalyzer::stringRecogHandler(QChar &ch, QString &str)
+void LexAnalyzer::lexChunk()
 {
-    ch = getNextChar();
-    while(ch != '"') {
-        str.push_back(ch);
-        ch = getNextChar();
+    try {
+        while(mainAnalyzer()) {}
+    }  catch (QString e) {
+        errorMsg = e;
+    }
+    isFileEnd = scanStop == nullptr || lexBegin < scanStop;
+}
+
+void LexAnalyzer::remapTokens(const QVector<int> &idMap, const QVector<int> &constantMap)
+{
+    for(int i = 0; i < tokenList.size(); i++) {
+        switch (tokenList.kind(i)) {
+        case SymbolItem::Type::ID:
+            tokenList.setIndex(i, idMap.at(tokenList.index(i)));
+            break;
+        case SymbolItem::Type::INTEGER:
+        case SymbolItem::Type::FLOAT:
+        case SymbolItem::Type::STRING:
+            tokenList.setIndex(i, constantMap.at(tokenList.index(i)));
+            break;
+        default:
+            break;
+        }
     }
-    generateSymbolFlag(str, SymbolItem::Type::STRING);
-    pushConstant(str, SymbolItem::Type::STRING);
-    str.clear();
 }
 
-bool LexAnalyzer::operatorRecogHandler(QChar &ch, QString &str)
+bool LexAnalyzer::startIncrementalLexAnalyze(qsizetype position, qsizetype removed, const QByteArray &inserted)
 {
-    if(findOperator(QString(ch)) == -1) {
-        scanBackspace();
+    if(position < 0 || removed < 0 || position > src.size() || removed > src.size() - position) {
+        errorMsg = "修改范围超出源码";
         return false;
     }
-    else {
-        str.push_back(ch);
-        while(true) {
-            ch = getNextChar();
-            str.push_back(ch);
-            if(findOperator(str) == -1) {
-                str.remove(str.length() - 1, 1);
+    src.replace(position, removed, inserted);
+    return relexRange(position, removed, inserted.size());
+}
+
+bool LexAnalyzer::startIncrementalLexAnalyze(const QByteArray &newSrc)
+{
+    const char *oldData = src.constData();
+    const char *newData = newSrc.constData();
+    qsizetype oldSize = src.size();
+    qsizetype newSize = newSrc.size();
+    qsizetype limit = qMin(oldSize, newSize);
+    qsizetype prefix = 0;
+    while(prefix < limit && oldData[prefix] == newData[prefix]) { prefix++; }
+    qsizetype suffix = 0;
+    while(suffix < limit - prefix && oldData[oldSize - 1 - suffix] == newData[newSize - 1 - suffix]) {
+        suffix++;
+    }
+    src = newSrc;
+    return relexRange(prefix, oldSize - prefix - suffix, newSize - prefix - suffix);
+}
+
+bool LexAnalyzer::relexRange(qsizetype position, qsizetype removed, qsizetype inserted)
+{
+    setInput(nullptr);
+    int oldNum = tokenList.size();
+    // 修改后源码过大时同样整体重新分析，由 startLexAnalyze 报告错误
+    if(!isLexComplete || src.size() > TokenBuffer::MaxSourceSize) {
+        initUtil();
+        bool isLexed = startLexAnalyze();
+        lastPatch = TokenPatch();
+        lastPatch.removed = oldNum;
+        lastPatch.inserted = tokenList.size();
+        lastPatch.isRenumbered = true;
+        return isLexed;
+    }
+
+    // 结束位置(含向后多读的一个字节)在修改位置之前的词法单元不受影响，从其后重新识别
+    int first = tokenList.findEnd(position);
+    qsizetype restart = first > 0 ? tokenList.offset(first - 1) + tokenList.length(first - 1) : 0;
+    windowBase = src.constData();
+    scanLimit = windowBase + src.size();
+    scanCursor = lexBegin = windowBase + restart;
+    scanStop = nullptr;
+    resumeState = LexTable::StateStart;
+    windowOffset = 0;
+    isFileEnd = false;
+
+    // 重新识别出的词法单元暂存在另一缓冲区，原 Token 表用于判断是否已经对齐
+    TokenBuffer relexed;
+    std::swap(tokenList, relexed);
+    // 新词法单元起始于修改内容之后，且原 Token 表在对应位置也有词法单元起始时，
+    // 两者之后读入的字节完全相同，识别结果只差位置平移
+    qsizetype shift = inserted - removed;
+    qsizetype editEnd = position + inserted;
+    int match = first;
+    bool isAligned = false;
+    bool isLexed = true;
+    try {
+        while(mainAnalyzer()) {
+            qsizetype offset = tokenList.offset(tokenList.size() - 1);
+            if(offset < editEnd) { continue; }
+            while(match < oldNum && relexed.offset(match) + shift < offset) { match++; }
+            if(match < oldNum && relexed.offset(match) + shift == offset) {
+                isAligned = true;
                 break;
             }
         }
-        generateSymbolFlag(str, SymbolItem::Type::OPERATOR);
-        scanBackspace();
-        str.clear();
-        return true;
-    }
-}
-
-QString LexAnalyzer::getMnemonicName(QString symbolStr, SymbolItem::Type type)
-{
-    switch (type) {
-    case SymbolItem::Type::ID:
-        return "$id"; break;
-    case SymbolItem::Type::INTEGER:
-        return "$integer"; break;
-    case SymbolItem::Type::FLOAT:
-        return "$floatnum"; break;
-    case SymbolItem::Type::KEYWORD:
-        return "$" + symbolStr; break;
-    case SymbolItem::Type::STRING:
-        return "$string"; break;
-    case SymbolItem::Type::OPERATOR:
-        QString str = getOperatorName(symbolStr);
-        if(str.isEmpty()) {return ""; }
-        else return "$" + getOperatorName(symbolStr);
-        break;
+    }  catch (QString e) {
+        errorMsg = e;
+        isLexed = false;
     }
-    return "";
-}
-
-QString LexAnalyzer::getOperatorName(QString symbol)
-{
-    int index = operatorList.indexOf(symbol);
-    switch (index) {
-    case 0: return "assign"; break;
-    case 1: return "plus"; break;
-    case 2: return "sub"; break;
-    case 3: return "mul"; break;
-    case 4: return "div"; break;
-    case 5: return "mod"; break;
-    case 6: return "eq"; break;
-    case 7: return "gre"; break;
-    case 8: return "geq"; break;
-    case 9: return "les"; break;
-    case 10: return "leq"; break;
-    case 11: return "neq"; break;
-    case 12: return "and"; break;
-    case 13: return "or"; break;
-    case 14: return "not"; break;
-    case 15: return "smc"; break;
-    case 16: return "cma"; break;
-    case 17: return "lpar"; break;
-    case 18: return "rpar"; break;
-    case 19: return "lbrc"; break;
-    case 20: return "rbrc"; break;
-    case 21: return "lsbrc"; break;
-    case 22: return "rsbrc"; break;
-    case 23: return "colon"; break;
-    default:
-        return "";
-        break;
+    std::swap(tokenList, relexed);
+
+    lastPatch = TokenPatch();
+    lastPatch.first = first;
+    if(isAligned) {
+        // 对齐处的词法单元与原 Token 相同，保留原 Token 并平移其后的位置
+        relexed.truncate(relexed.size() - 1);
+        lastPatch.removed = match - first;
+        scanCursor = lexBegin = scanLimit;
+        isFileEnd = true;
+    } else {
+        lastPatch.removed = oldNum - first;
+    }
+    lastPatch.inserted = relexed.size();
+    // 替换前后引用标识符表与常量表的序列相同时编号不变，否则按首次出现的顺序重新编号
+    bool isSameRefs = isLexed && isSameReferences(first, lastPatch.removed, relexed);
+    tokenList.replace(first, lastPatch.removed, relexed, shift);
+    lastPatch.isRenumbered = !isSameRefs && renumberTables();
+    isLexComplete = isLexed;
+    return isLexed;
+}
+
+bool LexAnalyzer::isSameReferences(int first, int count, const TokenBuffer &tokens) const
+{
+    int i = first;
+    int j = 0;
+    int end = first + count;
+    while(true) {
+        while(i < end && !isTableReference(tokenList.kind(i))) { i++; }
+        while(j < tokens.size() && !isTableReference(tokens.kind(j))) { j++; }
+        if(i == end || j == tokens.size()) { return i == end && j == tokens.size(); }
+        if(tokenList.kind(i) != tokens.kind(j) || tokenList.index(i) != tokens.index(j)) { return false; }
+        i++;
+        j++;
     }
 }
 
-void LexAnalyzer::sendSymbolMsg(QString &symbol)
-{
-    this->symbolMsg = symbol;
-}
+bool LexAnalyzer::renumberTables()
+{
+    QVector<int> idMap(identifierTable.size(), -1);
+    QVector<int> constantMap(constantPool.size(), -1);
+    int idNum = 0;
+    int constantNum = 0;
+    bool isChanged = false;
+    for(int i = 0; i < tokenList.size(); i++) {
+        int *map = nullptr;
+        int *num = nullptr;
+        switch (tokenList.kind(i)) {
+        case SymbolItem::Type::ID:
+            map = &idMap[tokenList.index(i)];
+            num = &idNum;
+            break;
+        case SymbolItem::Type::INTEGER:
+        case SymbolItem::Type::FLOAT:
+        case SymbolItem::Type::STRING:
+            map = &constantMap[tokenList.index(i)];
+            num = &constantNum;
+            break;
+        default:
+            continue;
+        }
+        if(*map < 0) { *map = (*num)++; }
+        isChanged = isChanged || *map != tokenList.index(i);
+    }
+    if(!isChanged && idNum == identifierTable.size() && constantNum == constantPool.size()) { return false; }
 
-void LexAnalyzer::generateSymbolFlag(QString symbolStr, SymbolItem::Type type)
-{
-    QString propName;
-    propName = "<" + getMnemonicName(symbolStr, type) + ", ";
-    switch (type) {
-    case SymbolItem::Type::ID:
-        propName = propName + QString::number(identifierList.size()) + ">"; break;
-    case SymbolItem::Type::INTEGER:
-    case SymbolItem::Type::FLOAT:
-    case SymbolItem::Type::STRING:
-        propName = propName + QString::number(constantList.size()) + ">"; break;
-    case SymbolItem::Type::KEYWORD:
-        propName = propName + "->"; break;
-    case SymbolItem::Type::OPERATOR:
-        propName = propName + "->"; break;
-        break;
+    // 按新编号的顺序重新登记，不再出现的项映射为 -1 而被丢弃
+    QVector<int> idOrder(idNum);
+    for(int id = 0; id < idMap.size(); id++) {
+        if(idMap.at(id) >= 0) { idOrder[idMap.at(id)] = id; }
+    }
+    SymbolTable identifiers;
+    for(int id : std::as_const(idOrder)) {
+        identifiers.intern(identifierTable.data(id), identifierTable.length(id));
+    }
+    QVector<int> constantOrder(constantNum);
+    for(int i = 0; i < constantMap.size(); i++) {
+        if(constantMap.at(i) >= 0) { constantOrder[constantMap.at(i)] = i; }
     }
-    symbolAnalyList.append(propName);
+    ConstantPool constants;
+    for(int i : std::as_const(constantOrder)) {
+        constants.addFrom(constantPool, i);
+    }
+    identifierTable = std::move(identifiers);
+    constantPool = std::move(constants);
+    remapTokens(idMap, constantMap);
+    return true;
 }
 
-bool LexAnalyzer::isLetter(QChar &character)
+bool LexAnalyzer::startFusedAnalyze()
 {
-    char ascii = character.toLatin1();
-    if((ascii >='a' && ascii <= 'z') || (ascii >= 'A' && ascii <= 'Z') || ascii == '_') {
-        return true;
-    }
-    return false;
+    setInput(nullptr);
+    isFeeding = true;
+    initUtil();
+    bool isPreProcessed = preServer->start(src, [this](const char *data, qsizetype length) {
+        feedWindow(data, length);
+    });
+    return finishFeed(isPreProcessed);
 }
 
-bool LexAnalyzer::isNumber(QChar &character)
+bool LexAnalyzer::startFusedAnalyze(const SourceFile &file)
 {
-    char ascii = character.toLatin1();
-    if(ascii >= '0' && ascii <= '9') {return true;}
-    return false;
+    setInput(nullptr);
+    src.clear();
+    isFeeding = true;
+    initUtil();
+    bool isPreProcessed = preServer->start(file, [this](const char *data, qsizetype length) {
+        feedWindow(data, length);
+    });
+    return finishFeed(isPreProcessed);
 }
 
-bool LexAnalyzer::isIdChar(QChar &character)
+bool LexAnalyzer::startPipelinedAnalyze()
 {
-    if(isLetter(character) || isNumber(character)) { return true; }
-    return false;
+    return pipelinedAnalyze([this](const PreProcess::OutputSink & sink) {
+        return preServer->start(src, sink);
+    });
 }
 
-bool LexAnalyzer::startPreProcess()
+bool LexAnalyzer::startPipelinedAnalyze(const SourceFile &file)
 {
-    if(!preServer->start(src)) {
+    src.clear();
+    return pipelinedAnalyze([this, &file](const PreProcess::OutputSink & sink) {
+        return preServer->start(file, sink);
+    });
+}
+
+bool LexAnalyzer::pipelinedAnalyze(const std::function<bool (const PreProcess::OutputSink &)> &preprocess)
+{
+    setInput(nullptr);
+    isFeeding = true;
+    initUtil();
+
+    SpscRing<QByteArray> chunks(PipelineDepth);
+    SpscRing<TokenBatch> batches(PipelineDepth);
+    bool isPreProcessed = true;
+    QString registerError;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(2);
+    // 预处理线程: 预处理结果分块放入队列
+    pool.start([&]() {
+        isPreProcessed = preprocess([&chunks](const char *data, qsizetype length) {
+            // 下游已经中止时以异常结束预处理
+            if(!chunks.push(QByteArray(data, int(length)))) { throw QString(); }
+        });
+        chunks.close();
+    });
+    // 登记线程: 按识别顺序查表并登记词法单元，编号与单线程时相同
+    pool.start([&]() {
+        TokenBatch batch;
+        try {
+            while(batches.pop(batch)) { registerBatch(batch); }
+        }  catch (QString e) {
+            registerError = e;
+            batches.abort();
+        }
+    });
+
+    // 当前线程识别词法单元
+    QString lexError;
+    TokenBatch batch;
+    tokenBatch = &batch;
+    try {
+        QByteArray chunk;
+        bool keep = true;
+        while(keep && chunks.pop(chunk)) {
+            // 跨越分块的词法单元在下一块中从保存的状态继续识别，每个字节只扫描一次
+            feedWindow(chunk.constData(), chunk.size());
+            keep = batches.push(std::move(batch));
+            batch = TokenBatch();
+        }
+        isFeeding = false;
+        // 队列取空说明预处理已经结束，预处理失败时与同步模式一样不再识别剩余内容
+        if(keep && isPreProcessed) {
+            while(mainAnalyzer()) {}
+        }
+    }  catch (QString e) {
+        lexError = e;
+    }
+    isFeeding = false;
+    tokenBatch = nullptr;
+    // 出错之前识别出的词法单元同样登记
+    batches.push(std::move(batch));
+    batches.close();
+    chunks.abort();
+    pool.waitForDone();
+
+    // 登记线程处理的词法单元都在识别出错的位置之前，预处理出错的位置又在所有已输出内容之后
+    if(!registerError.isEmpty()) {
+        errorMsg = registerError;
+        return false;
+    }
+    if(!lexError.isEmpty()) {
+        errorMsg = lexError;
+        return false;
+    }
+    if(!isPreProcessed) {
         errorMsg = preServer->getErrMsg();
         return false;
     }
     return true;
 }
 
-bool LexAnalyzer::startLexAnalyze(QStringList::Iterator & symbolIter)
+void LexAnalyzer::registerBatch(const TokenBatch &batch)
+{
+    const char *text = batch.text.constData();
+    for(int i = 0; i < batch.states.size(); i++) {
+        int length = batch.lengths.at(i);
+        acceptToken(batch.states.at(i), text, length, batch.offsets.at(i));
+        text += length;
+    }
+}
+
+bool LexAnalyzer::startLexAnalyze()
 {
     try {
+        checkSourceSize();
         bool keep = true;
         while(keep) {
             keep = mainAnalyzer();
+            if(progressHandler && windowOffset + (scanCursor - windowBase) >= progressMark) {
+                reportProgress();
+            }
         }
     }  catch (QString e) {
         errorMsg = e;
+        isLexComplete = false;
         return false;
     }
-    symbolIter = getSymbolBegin();
+    isLexComplete = input == nullptr && !isFeeding;
     return true;
 }
 
 int LexAnalyzer::lexAnalyByStep(QString &symbol)
 {
-    bool isEnd = false;
+    int status = lexNextToken();
+    if(status == 1) {
+        sendSymbolMsg(tokenList.text(tokenList.size() - 1));
+    } else {
+        sendSymbolMsg(QString());
+    }
+    symbol = symbolMsg;
+    return status;
+}
+
+int LexAnalyzer::lexNextToken()
+{
+    // 流式输入时不累积Token，内存占用与输入长度无关
+    if(input != nullptr) { tokenList.clear(); }
     try {
-        isEnd = !mainAnalyzer();
+        checkSourceSize();
+        return mainAnalyzer() ? 1 : 0;
     }  catch (QString e) {
         errorMsg = e;
         return -1;
     }
-    symbol = symbolMsg;
-    return isEnd ? 0 : 1;
 }
 
-QStringList::Iterator LexAnalyzer::getSymbolBegin()
+const TokenBuffer &LexAnalyzer::getTokens() const
 {
-    return symbolAnalyList.begin();
+    return tokenList;
 }
 
-QStringList::Iterator LexAnalyzer::getSymbolEnd() {
-    return symbolAnalyList.end();
+const LexAnalyzer::TokenPatch &LexAnalyzer::getLastPatch() const
+{
+    return lastPatch;
+}
+
+bool LexAnalyzer::isResultComplete() const
+{
+    return isLexComplete;
 }
 
 int LexAnalyzer::getSymbolNum()
 {
-    return symbolAnalyList.length();
+    return tokenList.size();
 }
 
-QList<LexAnalyzer::SymbolItem>::Iterator LexAnalyzer::getIdBegin()
+const SymbolTable &LexAnalyzer::getIdentifiers() const
 {
-    return identifierList.begin();
+    return identifierTable;
 }
 
 int LexAnalyzer::getIdNum()
 {
-    return identifierList.length();
+    return identifierTable.size();
 }
 
-QList<LexAnalyzer::SymbolItem>::Iterator LexAnalyzer::getConstantBegin()
+const ConstantPool &LexAnalyzer::getConstants() const
 {
-    return constantList.begin();
+    return constantPool;
 }
 
 int LexAnalyzer::getConstantNum()
 {
-    return constantList.length();
+    return constantPool.size();
 }
 
 QString LexAnalyzer::getErrorMsg() const
@@ -1,17 +1,24 @@
 #ifndef LEXANALYZER_H
 #define LEXANALYZER_H
 
+#include <functional>
+
+#include <QByteArray>
 #include <QDir>
 #include <QFile>
 #include <QList>
-#include <QMap>
 #include <QString>
 #include <QStringList>
+#include <QVector>
 #include <QIODevice>
-#include <QFileDialog>
 #include <QTextStream>
 
+#include "constantpool.h"
+#include "lextable.h"
 #include "preprocess.h"
+#include "sourcefile.h"
+#include "symboltable.h"
+#include "tokenbuffer.h"
 
 /**
  * @brief 词法识别器类
@@ -19,14 +26,50 @@
  * 处理识别出源码中对应词法单元
  * 提供全体识别与调用子程序逐次识别的两种接口
  * 可处理的词法单元可见对应表格
+ * 各实例之间不共享可变状态，不同实例可以在不同线程中同时使用
+ * 预处理与词法分析都直接处理字节，源码可以是 UTF-8 或 Latin-1，
+ * 非 ASCII 字节只允许出现在注释与字符串中，UTF-16 的 QString 接口仅为界面保留
  */
 class LexAnalyzer
 {
 public:
+    using ProgressHandler = PreProcess::ProgressHandler;
+
     LexAnalyzer();
     ~LexAnalyzer();
-    const QString &getSrc() const;
+    const QByteArray &getSrc() const;
+    /**
+     * @brief setSrc 设置 UTF-8 或 Latin-1 编码的源码，与传入数据隐式共享不产生拷贝
+     * @details 扫描时以 QByteArray 末尾的 '\0' 作为哨兵，
+     *  因此不能传入由 QByteArray::fromRawData 构造的不以 '\0' 结尾的数据
+     * @param newSrc 源码
+     */
+    void setSrc(const QByteArray &newSrc);
+    /**
+     * @brief setSrc 界面适配接口，将编辑框中的 UTF-16 文本转为 UTF-8 后分析
+     * @details 之后 getSrc 与常量表中的字符串均为 UTF-8，界面按 UTF-8 解码显示即可
+     * @param newSrc 源码
+     */
     void setSrc(const QString &newSrc);
+    /**
+     * @brief setInput 设置流式输入设备，分析时按窗口分块读取，不保存完整源码
+     * @details 设备由调用者持有，需在分析结束前保持打开
+     * @param device 已打开的可读设备，如文件、管道或套接字
+     */
+    void setInput(QIODevice * device);
+    /**
+     * @brief setInput 以文件描述符作为流式输入
+     * @param fd 已打开的可读文件描述符，如管道或标准输入，描述符由调用者关闭
+     * @return 是否成功打开
+     */
+    bool setInput(int fd);
+    /**
+     * @brief setWindowSize 设置流式输入每次读取的字节数
+     * @details 扫描窗口只保留正在识别的词法单元与新读入的数据，
+     *  内存占用约为窗口大小加最长词法单元长度
+     * @param bytes 每次读取的字节数
+     */
+    void setWindowSize(int bytes);
 
 public:
     /**
@@ -34,8 +77,7 @@ public:
      */
     class SymbolItem {
     public:
-        enum class Type{    KEYWORD=1, ID = 21, INTEGER = 22,
-                                    FLOAT = 23, STRING = 24, OPERATOR=25 };
+        using Type = TokenBuffer::Kind;
         SymbolItem() {value = "";}
         SymbolItem(QString value, Type itemType) {
             this->value = value;
@@ -48,6 +90,18 @@ public:
         Type itemType;
     };
 
+    /**
+     * @brief The TokenPatch struct 增量分析对 Token 表的修改
+     * @details 原 Token 表中 [first, first + removed) 被替换为新 Token 表中 [first, first + inserted)，
+     *  之后的 Token 只有位置平移；isRenumbered 为真时标识符与常量重新编号，其余 Token 的表索引也可能变化
+     */
+    struct TokenPatch {
+        int first = 0;              // 第一个被替换的 Token
+        int removed = 0;            // 被替换的原 Token 数
+        int inserted = 0;           // 替换后的 Token 数
+        bool isRenumbered = false;  // 标识符表或常量表是否重新编号
+    };
+
 public:
     friend class PreProcess;
     /**
@@ -60,13 +114,97 @@ public:
      * @return 子程序执行是否成功
      */
     bool startPreProcess();
+    /**
+     * @brief startPreProcess 直接对映射的源码文件调用预处理子程序，结果作为词法分析的源码
+     * @param file 源码文件
+     * @return 子程序执行是否成功
+     */
+    bool startPreProcess(const SourceFile & file);
+
+    /**
+     * @brief setIncludeDir 设置预处理时相对包含路径的查找目录
+     * @param dir 查找目录，为空时使用当前工作目录
+     */
+    void setIncludeDir(const QString & dir);
+    /**
+     * @brief setIncludeCache 与其他分析器共用包含文件缓存
+     * @param cache 包含文件缓存
+     */
+    void setIncludeCache(const QSharedPointer<IncludeCache> & cache);
+    /**
+     * @brief setProgressHandler 设置预处理与全体词法分析的进度回调
+     * @details 回调在执行分析的线程中、两个词法单元之间调用，此时可以读取已识别的 Token，
+     *  大约每处理 ProgressStep 字节调用一次，返回 false 时分析以“分析已取消”失败；
+     *  参数为已处理的字节数与总字节数，流式输入时总字节数为 -1
+     * @param handler 进度回调，为空时不报告
+     */
+    void setProgressHandler(const ProgressHandler & handler);
 
     /**
      * @brief startLexAnalyze 开始全体词法分析
-     * @param symbolIter 带出Token链表的起始迭代器
-     * @return  词法分析是否成功
+     * @return  词法分析是否成功，结果通过 getTokens 获取
      */
-    bool startLexAnalyze(QStringList::Iterator & symbolIter);
+    bool startLexAnalyze();
+
+    /**
+     * @brief startParallelLexAnalyze 将源码分块后并行词法分析
+     * @details 预处理结果中字符串之外的空格都是词法单元的边界，在这些位置把源码分成若干块，
+     *  各块由独立的分析器同时识别，再按块的顺序合并 Token 表、标识符表与常量表，
+     *  结果(包括出错时已识别的内容)与 startLexAnalyze 相同；源码较小时直接顺序分析
+     * @param threadCount 线程数，不大于 0 时使用 QThread::idealThreadCount
+     * @return 词法分析是否成功，结果通过 getTokens 获取
+     */
+    bool startParallelLexAnalyze(int threadCount = 0);
+
+    /**
+     * @brief startIncrementalLexAnalyze 修改源码中的一段字节，只重新识别受影响的词法单元
+     * @details 从编辑位置之前最近的词法单元边界重新识别，识别出的词法单元与原 Token 表在编辑位置之后
+     *  重新对齐时停止，其后的 Token 只平移位置；标识符与常量仍按首次出现的顺序编号，不再出现的项被删除，
+     *  结果与对修改后的源码完整分析相同，修改情况通过 getLastPatch 获取
+     *  Token 表不是当前源码的完整识别结果(如尚未分析或上次分析出错)时对修改后的源码完整分析
+     * @param position 修改的起始字节位置
+     * @param removed 删除的字节数
+     * @param inserted 插入的字节
+     * @return 词法分析是否成功
+     */
+    bool startIncrementalLexAnalyze(qsizetype position, qsizetype removed, const QByteArray & inserted);
+    /**
+     * @brief startIncrementalLexAnalyze 以修改后的完整源码增量分析
+     * @details 与当前源码比较共同的前缀与后缀得到修改范围，适合编辑框等只能取得完整文本的调用者
+     * @param newSrc 修改后的源码
+     * @return 词法分析是否成功
+     */
+    bool startIncrementalLexAnalyze(const QByteArray & newSrc);
+
+    /**
+     * @brief startFusedAnalyze 预处理与词法分析同步进行
+     * @details 预处理结果分块直接送入扫描窗口，不生成完整的预处理结果，
+     *  Token 表、标识符表与常量表的内容与先预处理再分析时相同，src 保持不变
+     * @return 预处理与词法分析是否都成功
+     */
+    bool startFusedAnalyze();
+    /**
+     * @brief startFusedAnalyze 对映射的源码文件同步进行预处理与词法分析
+     * @param file 源码文件
+     * @return 预处理与词法分析是否都成功
+     */
+    bool startFusedAnalyze(const SourceFile & file);
+
+    /**
+     * @brief startPipelinedAnalyze 以三线程流水线同步进行预处理与词法分析
+     * @details 预处理、词法识别与查表登记分别在三个线程中进行：
+     *  预处理结果分块经无锁环形队列送入识别线程，识别出的词法单元成批送入登记线程，
+     *  识别线程与 startFusedAnalyze 一样经 feedWindow 接收分块，跨越分块的词法单元不会重新扫描，
+     *  结果与 startFusedAnalyze 相同，适合单个较大的源码文件
+     * @return 预处理与词法分析是否都成功
+     */
+    bool startPipelinedAnalyze();
+    /**
+     * @brief startPipelinedAnalyze 以三线程流水线处理映射的源码文件
+     * @param file 源码文件
+     * @return 预处理与词法分析是否都成功
+     */
+    bool startPipelinedAnalyze(const SourceFile & file);
 
     /**
      * @brief lexAnalyByStep 开始单步词法分析
@@ -75,14 +213,27 @@ public:
      */
     int lexAnalyByStep(QString & symbol);
 
+    /**
+     * @brief lexNextToken 识别下一个词法单元，结果通过 getTokens 获取
+     * @details 流式输入时只保留当前识别出的Token，Token 表中仅有一项；
+     *  标识符表与常量表仍随不同的标识符与常量增长，输入超过 TokenBuffer::MaxSourceSize 时识别出错
+     * @return 1 识别出一个Token，0 已经到达文件末尾，-1 识别出错
+     */
+    int lexNextToken();
+
     // 获取相关列表的迭代器与表项数
 
-    QStringList::Iterator getSymbolBegin();
-    QStringList::Iterator getSymbolEnd();
+    const TokenBuffer & getTokens() const;
+    const TokenPatch & getLastPatch() const;
+    /**
+     * @brief isResultComplete Token 表是否为当前源码的完整识别结果
+     * @return 为假时增量分析将对修改后的源码完整分析
+     */
+    bool isResultComplete() const;
     int getSymbolNum();
-    QList<SymbolItem>::Iterator getIdBegin();
+    const SymbolTable & getIdentifiers() const;
     int getIdNum();
-    QList<SymbolItem>::Iterator getConstantBegin();
+    const ConstantPool & getConstants() const;
     int getConstantNum();
 
     /**
@@ -92,175 +243,198 @@ public:
     QString getErrorMsg() const;
 
 private:
-    QString src;                                        // 存放输入源码
-    QString scanBufferA;                        // 左扫描半区
-    QString scanBufferB;                        // 右扫描半区
+    QByteArray src;                                   // 存放输入源码(UTF-8)
+    QIODevice * input = nullptr;        // 流式输入设备，为空时分析 src
+    QFile inputFile;                    // 由文件描述符打开的输入
+    QByteArray window;                  // 流式输入的扫描窗口
+    int windowSize = 64 * 1024;         // 流式输入每次读取的字节数
     PreProcess * preServer = nullptr;   // 预处理器指针
     QString symbolMsg;                      // 单步处理返回的Token项
     QString errorMsg;                           // 错误提示信息
 
-    int lexBegin = 0;                               // 词法单元开始指针
-    int lexForward = 0;                         // 词法单元向前扫描指针
+    const char * windowBase = nullptr;  // 扫描窗口起始指针
+    const char * scanLimit = nullptr;   // 扫描窗口结束指针，该处为哨兵 '\0'
+    const char * scanCursor = nullptr;  // 下一个待扫描的字节
+    const char * lexBegin = nullptr;    // 词法单元起始字节
+    qsizetype windowOffset = 0;         // 扫描窗口首字节在源码中的位置
+    const char * scanStop = nullptr;    // 分块识别时的块末尾，起始于此后的词法单元属于下一块
 
-    bool isReady = false;                       // 是否已经启动分析
-    bool isBufferA = false;                     // 是否正在左半区
     bool isFileEnd = false;                     // 文件是否结束
-    bool isBackEngaged = false;         // 是否为半区加载后的扫描后退
+    bool isFeeding = false;                     // 是否正在接收预处理器分块送入的数据
+    bool isWindowEnd = false;                   // 本次识别是否读到了窗口末尾的哨兵
+    quint8 resumeState = LexTable::StateStart;  // 同步预处理时窗口末尾未识别完的词法单元所处的状态
+    bool isLexComplete = false;                 // Token 表是否为 src 的完整识别结果
+    TokenPatch lastPatch;                       // 最近一次增量分析对 Token 表的修改
+    ProgressHandler progressHandler;            // 进度回调
+    qsizetype progressMark = 0;                 // 下一次报告进度的源码位置
 
-    QMap<QString, int> keywordMap;  // 用于快速查找关键词的Map
-    QList<SymbolItem> identifierList;   // 标识符列表
-    QList<SymbolItem> constantList;     // 常量表
-    QStringList symbolAnalyList;            // 词法分析Token表
-
-private:
-    const int BufferLength = 128;           // 扫描缓冲区长度
-    const int keywordNum = 20;            // 关键词数量
-
-    QStringList keywordList = {
-        "void", "int", "long", "float", "double",
-        "bool", "string", "if", "elif", "else", "return",
-        "while", "for", "break", "continue", "switch",
-        "case", "default", "true", "false"
+    /**
+     * @brief The TokenBatch struct 流水线模式下识别线程送往登记线程的一批词法单元
+     */
+    struct TokenBatch {
+        QByteArray text;            // 各词法单元的字节，依次相连
+        QVector<quint8> states;     // 终止状态
+        QVector<qsizetype> offsets; // 在源码中的位置
+        QVector<int> lengths;       // 字节数
+        void append(quint8 state, qsizetype offset, const char *data, int length) {
+            text.append(data, length);
+            states.append(state);
+            offsets.append(offset);
+            lengths.append(length);
+        }
     };
+    TokenBatch * tokenBatch = nullptr;  // 流水线模式下正在填充的批次
 
-    QStringList operatorList = {
-        "=", "+", "-", "*", "/", "%", "==", ">", ">=", "<", "<=",
-        "!=", "&", "|", "!", ";", ",", "(", ")", "{", "}", "[", "]",":"
-    };
+    SymbolTable identifierTable;        // 标识符表，同一标识符只登记一次
+    ConstantPool constantPool;          // 常量表，相同的常量只登记一次
+    TokenBuffer tokenList;                      // 词法分析Token表
 
 private:
-    /**
-     * @brief initReserveMap 初始化内部查找变量
-     */
-    void initReserveMap();
+    const int PipelineDepth = 64;           // 流水线各队列的容量
+    const qsizetype MinChunkLength = 1024 * 1024;   // 并行分析时每块的最小字节数
+    const qsizetype ProgressStep = 256 * 1024;      // 相邻两次报告进度之间识别的字节数
 
+private:
     /**
      * @brief mainAnalyzer 单步主词法分析函数
+     * @details 按字符类别表与状态转移表逐字节运行状态机，到达终止状态时识别出一个词法单元，
+     *  标识符、数字与字符串的其余字节由 ByteScan 按向量批量跳过，词法单元以源码中的一段区间登记
      * @return 该次处理是否成功
      */
     bool mainAnalyzer();
+    /**
+     * @brief acceptToken 根据终止状态登记识别出的词法单元
+     * @param state 终止状态
+     * @param text 词法单元起始指针
+     * @param length 词法单元字节数
+     * @param offset 词法单元在源码中的位置
+     */
+    void acceptToken(quint8 state, const char *text, int length, qsizetype offset);
 
     void resetResult();
-
     /**
-     * @brief engageBuffer 装载扫描半区
-     * @param isLeftBuffer 是否需要装载左半区
+     * @brief reportProgress 报告已识别的字节数，回调要求取消时抛出异常
      */
-    void engageBuffer(bool isLeftBuffer);
+    void reportProgress();
+
     /**
-     * @brief replaceBufferChar 替换缓冲区内特定数据
-     * @param buffer 指定缓冲区引用
-     * @param length 替换长度
-     * @param src 源码
+     * @brief refillWindow 扫描到窗口末尾的哨兵时装载后续源码
+     * @details 内存中的源码整体即为一个窗口，没有后续内容
+     *  流式输入时丢弃正在识别的词法单元之前的字节，再从设备读入至多 windowSize 字节
+     * @return 是否装载了新的内容
      */
-    void replaceBufferChar(QString & buffer, int length, QString & src);
-
+    bool refillWindow();
     /**
-     * @brief getNextChar 获取需要扫描的下一个字符
-     * @return Unicode字符
+     * @brief compactWindow 丢弃窗口中已经识别完的字节，只保留正在识别的词法单元
+     * @return 保留的字节数
      */
-    QChar getNextChar();
-
+    qsizetype compactWindow();
     /**
-     * @brief scanBackspace 扫描退格
+     * @brief rebaseWindow 窗口内容变化后重新设置扫描指针
+     * @details 窗口末尾在流中的位置超过 TokenBuffer::MaxSourceSize 时以异常报告错误
+     * @param cursor 下一个待扫描字节在窗口中的位置
      */
-    void scanBackspace();
-
-
+    void rebaseWindow(qsizetype cursor);
     /**
-     * @brief findKeyword  查找目标是否为关键字
-     * @param target 查找目标
-     * @return 查找到的关键词表索引，若不存在则返回-1
+     * @brief feedWindow 接收预处理器送入的一块数据并识别其中完整的词法单元
+     * @details 可能延续到下一块数据中的词法单元留在窗口中，下一块到来时从保存的状态继续识别，
+     *  已经扫描过的字节不再重新扫描
+     * @param data 数据起始指针
+     * @param length 数据字节数
      */
-    int findKeyword(QString & target);
+    void feedWindow(const char *data, qsizetype length);
     /**
-     * @brief findOperator 查找目标是否为操作符
-     * @param target 查找目标
-     * @return 查找到的操作符表索引，若不存在则返回-1
+     * @brief finishFeed 预处理结束后识别窗口中剩余的词法单元
+     * @param isPreProcessed 预处理是否成功
+     * @return 预处理与词法分析是否都成功
      */
-    int findOperator(QString target);
-
+    bool finishFeed(bool isPreProcessed);
     /**
-     * @brief pushId 将标识符压入表中
-     * @param id 指定标识符
+     * @brief pipelinedAnalyze 启动预处理与登记线程，在当前线程识别词法单元
+     * @param preprocess 以给定的 sink 执行预处理
+     * @return 预处理与词法分析是否都成功
      */
-    void pushId(QString & id);
+    bool pipelinedAnalyze(const std::function<bool(const PreProcess::OutputSink &)> & preprocess);
     /**
-     * @brief pushConstant 将常数压入表中
-     * @param constant 指定常数
-     * @param type 常数类型
+     * @brief splitChunks 在字符串之外的空格处把源码分成若干块
+     * @details 各段内引号数量并行统计，由其奇偶性确定每个分割点是否位于字符串中
+     * @param count 期望的块数
+     * @return 各块起始位置，末尾附加源码长度，空块已去除
      */
-    void pushConstant(QString & constant, SymbolItem::Type type);
-
+    QVector<qsizetype> splitChunks(int count) const;
     /**
-     * @brief symbolRecogHandler 标识符识别函数
-     * @param ch 正在扫描的字符
-     * @param str 暂存字符串
+     * @brief lexChunk 识别起始于 [scanCursor, scanStop) 的全部词法单元
+     * @details 出错时错误信息保存在 errorMsg，未到达块末尾就结束时 isFileEnd 为真
      */
-    void symbolRecogHandler(QChar & ch, QString & str);
+    void lexChunk();
     /**
-     * @brief numberRecogHandler 数字识别函数
-     * @param ch 正在扫描的字符
-     * @param str 暂存字符串
+     * @brief remapTokens 按映射换算 Token 表中标识符与常量的编号
+     * @details 用于合并分块识别的结果与增量分析后重新编号
+     * @param idMap 原标识符编号到新编号的映射
+     * @param constantMap 原常量编号到新编号的映射
      */
-    void numberRecogHandler(QChar & ch, QString & str);
+    void remapTokens(const QVector<int> & idMap, const QVector<int> & constantMap);
     /**
-     * @brief stringRecogHandler 字符串识别函数
-     * @param ch 正在扫描的字符
-     * @param str 暂存字符串
+     * @brief relexRange 源码修改后重新识别受影响的词法单元
+     * @details 调用前 src 已经修改，isLexComplete 为真时 Token 表仍为修改前源码的完整识别结果
+     * @param position 修改的起始字节位置
+     * @param removed 删除的字节数
+     * @param inserted 插入的字节数
+     * @return 词法分析是否成功
      */
-    void stringRecogHandler(QChar & ch, QString & str);
+    bool relexRange(qsizetype position, qsizetype removed, qsizetype inserted);
     /**
-     * @brief operatorRecogHandler 操作符识别函数
-     * @param ch 正在扫描的字符
-     * @param str 暂存字符串
-     * @return 是否为操作符
+     * @brief isSameReferences Token 表中 [first, first + count) 与给定 Token 引用的标识符与常量序列是否相同
+     * @param first 起始序号
+     * @param count Token 数
+     * @param tokens 另一组 Token
+     * @return 是否相同
      */
-    bool operatorRecogHandler(QChar & ch, QString & str);
-
+    bool isSameReferences(int first, int count, const TokenBuffer & tokens) const;
     /**
-     * @brief getMnemonicName 获得指定类型的助记符名称
-     * @param symbolStr 标识符名
-     * @param type 类型
-     * @return  助记符名称
+     * @brief renumberTables 按 Token 表中首次出现的顺序重新编号标识符与常量，删除不再出现的项
+     * @return 编号是否有变化
      */
-    QString getMnemonicName(QString symbolStr, SymbolItem::Type type);
+    bool renumberTables();
     /**
-     * @brief getOperatorName 获取操作符名称
-     * @param symbol 指定操作符
-     * @return  操作符名称
+     * @brief registerBatch 登记一批词法单元
+     * @param batch 识别线程送来的词法单元
      */
-    QString getOperatorName(QString symbol);
+    void registerBatch(const TokenBatch & batch);
+
     /**
-     * @brief sendSymbolMsg 发送单步分析结果
-     * @param symbol 分析结果
+     * @brief checkSourceSize 检查内存中的源码能否由 Token 表记录位置
+     * @details 超过 TokenBuffer::MaxSourceSize 时以异常报告错误，流式输入在 rebaseWindow 中检查
      */
-    void sendSymbolMsg(QString & symbol);
+    void checkSourceSize() const;
+
     /**
-     * @brief generateSymbolFlag 生成单步分析Token
-     * @param symbolStr 词法单元内容
-     * @param type 类型
+     * @brief getNextChar 获取需要扫描的下一个字符
+     * @details 直接读取源码，不再拷贝到扫描缓冲区
+     *  窗口末尾的 '\0' 作为哨兵，只有读到 '\0' 时才需要判断是否到达窗口末尾
+     * @return UTF-8 字节，源码结束后一直返回 0
      */
-    void generateSymbolFlag(QString symbolStr, SymbolItem::Type type);
+    char getNextChar();
 
     /**
-     * @brief isLetter 是否为字母
-     * @param character 给定字符
-     * @return 是否为字母
+     * @brief scanBackspace 扫描退格
      */
-    bool isLetter(QChar & character);
+    void scanBackspace();
+
     /**
-     * @brief isNumber 是否为数字字符
-     * @param character 给定字符
-     * @return 是否为数字字符
+     * @brief sendSymbolMsg 发送单步分析结果
+     * @param symbol 分析结果
      */
-    bool isNumber(QChar & character);
+    void sendSymbolMsg(const QString & symbol);
     /**
-     * @brief isIdChar 是否为可构成标识符字符
-     * @param character 给定字符
-     * @return 是否为可构成标识符字符
+     * @brief generateSymbolFlag 登记识别出的Token
+     * @details 只记录类型、位置与表索引，显示文本由 TokenBuffer 按需生成
+     * @param type 类型
+     * @param index 表索引，关键字与操作符为对应枚举值
+     * @param offset 词法单元在源码中的位置
+     * @param length 词法单元字节数
      */
-    bool isIdChar(QChar & character);
+    void generateSymbolFlag(SymbolItem::Type type, int index, qsizetype offset, int length);
 
 };
 
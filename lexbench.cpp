@@ -0,0 +1,516 @@
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "bytescan.h"
+#include "lexanalyzer.h"
+#include "preprocess.h"
+
+/**
+ * lex_bench 预处理与词法分析吞吐量基准
+ * 按给定倍数从最小规模到最大规模生成与 res/main.txt 形态相近的类C语料
+ * (注释、#define、#include、字符串与各类操作符)，分别统计以下阶段:
+ *  pre   预处理: 对原始语料执行 PreProcess::start
+ *  macro 宏引用密集的预处理: 对已去除注释与多余空白、宏引用密集的语料执行 PreProcess::start，
+ *        计时覆盖整个预处理流程，注释与空白的处理在该语料上几乎不产生开销，耗时以宏替换为主
+ *  lex   词法分析: 对预处理结果执行 LexAnalyzer::startLexAnalyze
+ *  plex  分块并行词法分析: 对预处理结果执行 LexAnalyzer::startParallelLexAnalyze，默认不测量
+ *  incr  增量词法分析: 完整分析预处理结果后在随机的空格处插入并删除空格，耗时为单次编辑的平均值，默认不测量
+ *  fused 同步预处理与词法分析: 对原始语料执行 LexAnalyzer::startFusedAnalyze，默认不测量
+ *  pipe  三线程流水线: 对原始语料执行 LexAnalyzer::startPipelinedAnalyze，默认不测量
+ * 每个阶段输出耗时、MB/s、tokens/s、阶段内峰值常驻内存与内存分配次数
+ */
+
+namespace {
+
+std::atomic<quint64> allocCount(0);    // 进程内累计内存分配次数
+
+} // namespace
+
+#if defined(__GLIBC__)
+// glibc 下直接拦截 malloc 系列函数，Qt 容器与 operator new 的分配都会经过这里
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t num, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size)
+{
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+#else
+// 其他平台只能统计经过 operator new 的分配
+void *operator new(std::size_t size)
+{
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    if(void *ptr = std::malloc(size ? size : 1)) { return ptr; }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+#endif
+
+namespace {
+
+/**
+ * @brief 阶段测量结果
+ */
+struct StageResult {
+    qint64 inputBytes = 0;      // 输入字节数
+    qint64 elapsedNs = 0;       // 耗时(纳秒)
+    qint64 tokens = -1;         // 产生的 Token 数，非词法阶段为 -1
+    qint64 peakRssKb = -1;      // 阶段内峰值常驻内存(KB)，无法获取时为 -1
+    quint64 allocs = 0;         // 阶段内内存分配次数
+    bool ok = true;             // 阶段是否执行成功
+    QString errMsg;             // 错误信息
+};
+
+/**
+ * @brief 简单线性同余随机数，保证不同平台生成的语料一致
+ */
+class Random {
+public:
+    explicit Random(quint32 seed) : state(seed) {}
+    quint32 next(quint32 bound) {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) % bound;
+    }
+private:
+    quint32 state;
+};
+
+/**
+ * @brief resetPeakRss 重置进程峰值常驻内存统计
+ * @details 仅 Linux 支持按阶段重置，其他平台读到的是进程启动以来的峰值
+ */
+void resetPeakRss()
+{
+#if defined(Q_OS_LINUX)
+    QFile file("/proc/self/clear_refs");
+    if(file.open(QIODevice::WriteOnly)) { file.write("5"); }
+#endif
+}
+
+/**
+ * @brief peakRssKb 读取峰值常驻内存
+ * @return 峰值常驻内存(KB)，无法获取时返回 -1
+ */
+qint64 peakRssKb()
+{
+#if defined(Q_OS_LINUX)
+    QFile file("/proc/self/status");
+    if(file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        while(!file.atEnd()) {
+            QByteArray line = file.readLine();
+            if(line.startsWith("VmHWM:")) {
+                return line.mid(6).trimmed().split(' ').first().toLongLong();
+            }
+        }
+    }
+    return -1;
+#elif defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) { return -1; }
+    return qint64(counters.PeakWorkingSetSize / 1024);
+#elif defined(Q_OS_MACOS)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return qint64(usage.ru_maxrss / 1024);
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return qint64(usage.ru_maxrss);
+#endif
+}
+
+const char * const typeNames[] = { "int", "float", "bool", "string", "long", "double" };
+const char * const compareOps[] = { "==", "!=", ">", ">=", "<", "<=" };
+const char * const arithOps[] = { "+", "-", "*", "%" };
+
+/**
+ * @brief appendFunction 生成一个形如 res/main.txt 的函数体
+ * @param text 语料
+ * @param rand 随机数
+ * @param index 函数序号
+ * @param macroNum 可引用的宏数量
+ */
+void appendFunction(QByteArray & text, Random & rand, int index, int macroNum)
+{
+    QByteArray name = "func" + QByteArray::number(index);
+    text += "// " + name + " generated for benchmark\n";
+    if(index % 4 == 0) {
+        text += "/*\n * block comment " + QByteArray::number(index) + "\n */\n";
+    }
+    text += QByteArray(typeNames[rand.next(6)]) + " " + name + "(int count, float scale) {\n";
+    text += "    string label = \"bench string " + QByteArray::number(index) + "\";\n";
+    text += "    bool isEven = true;\n";
+    text += "    int total = M" + QByteArray::number(rand.next(macroNum)) + ";\n";
+    text += "    while(count " + QByteArray(compareOps[rand.next(6)]) + " 0) {\n";
+    text += "\tcount = count " + QByteArray(arithOps[rand.next(4)]) + " "
+            + QByteArray::number(rand.next(100) + 1) + ";\n";
+    text += "\tif(label[count] != \"\\0\") {\n";
+    text += "\t    total = total + scale * 3.14159 - M"
+            + QByteArray::number(rand.next(macroNum)) + ";\n";
+    text += "\t} else {\n\t    isEven = !isEven;\n\t}\n";
+    text += "    }\n";
+    text += "    switch(isEven) {\n";
+    text += "        case true: return total; break;\n";
+    text += "        case false: return " + name + "(count, scale); break;\n";
+    text += "    }\n};\n\n";
+}
+
+/**
+ * @brief appendDefine 生成一条宏定义
+ * @param text 语料
+ * @param name 宏名
+ * @param value 宏的值
+ */
+void appendDefine(QByteArray & text, const QByteArray & name, int value)
+{
+    text += "#define " + name + " " + QByteArray::number(value) + "\n";
+}
+
+/**
+ * @brief buildHeader 生成被包含的头文件内容
+ * @param macroNum 宏数量
+ * @return 头文件内容
+ */
+QByteArray buildHeader(int macroNum)
+{
+    QByteArray text = "/* shared benchmark header */\n";
+    for(int i = 0; i < macroNum; i++) {
+        appendDefine(text, "M" + QByteArray::number(i), i * 7);
+    }
+    Random rand(7);
+    for(int i = 0; i < 4; i++) {
+        appendFunction(text, rand, 100000 + i, macroNum);
+    }
+    return text;
+}
+
+/**
+ * @brief buildCorpus 生成预处理阶段的原始语料
+ * @details 直接按各阶段使用的 UTF-8 字节生成，最大规模下也只占一份语料大小的内存
+ * @param size 目标字节数
+ * @param headerPath 被包含的头文件路径
+ * @param macroNum 宏数量
+ * @return 语料
+ */
+QByteArray buildCorpus(qint64 size, const QString & headerPath, int macroNum)
+{
+    QByteArray text;
+    text.reserve(int(qMin<qint64>(size + 4096, INT_MAX)));
+    const QByteArray include = "#include \"" + headerPath.toUtf8() + "\"\n";
+    Random rand(42);
+    for(int index = 0; text.size() < size; index++) {
+        // 每隔若干函数包含一次公共头文件，模拟包含密集的源码
+        if(index % 64 == 0) {
+            text += include;
+            appendDefine(text, "LOCAL" + QByteArray::number(index), index);
+        }
+        appendFunction(text, rand, index, macroNum);
+    }
+    return text;
+}
+
+/**
+ * @brief buildMacroCorpus 生成宏替换阶段的语料
+ * @details 语料已不含注释与多余空白，宏引用密集，耗时主要来自宏替换
+ * @param size 目标字节数
+ * @param macroNum 宏数量
+ * @return 语料
+ */
+QByteArray buildMacroCorpus(qint64 size, int macroNum)
+{
+    QByteArray text;
+    text.reserve(int(qMin<qint64>(size + 4096, INT_MAX)));
+    for(int i = 0; i < macroNum; i++) {
+        appendDefine(text, "M" + QByteArray::number(i), i * 7);
+    }
+    Random rand(1234);
+    while(text.size() < size) {
+        text += "total = M" + QByteArray::number(rand.next(macroNum))
+                + " + value " + arithOps[rand.next(4)]
+                + " M" + QByteArray::number(rand.next(macroNum)) + "; ";
+    }
+    return text;
+}
+
+/**
+ * @brief runPreProcess 测量一次预处理
+ * @param src 语料，执行后为预处理结果
+ * @return 测量结果
+ */
+StageResult runPreProcess(QByteArray & src)
+{
+    StageResult result;
+    result.inputBytes = src.size();
+    resetPeakRss();
+    quint64 allocBase = allocCount.load();
+    QElapsedTimer timer;
+    timer.start();
+    PreProcess server;
+    result.ok = server.start(src);
+    result.elapsedNs = timer.nsecsElapsed();
+    result.allocs = allocCount.load() - allocBase;
+    result.peakRssKb = peakRssKb();
+    if(!result.ok) { result.errMsg = server.getErrMsg(); }
+    return result;
+}
+
+/**
+ * @brief runLexAnalyze 测量一次词法分析
+ * @param src 预处理结果
+ * @param parallel 是否分块并行分析
+ * @return 测量结果
+ */
+StageResult runLexAnalyze(const QByteArray & src, bool parallel)
+{
+    StageResult result;
+    result.inputBytes = src.size();
+    LexAnalyzer util;
+    util.setSrc(src);
+    util.initUtil();
+    resetPeakRss();
+    quint64 allocBase = allocCount.load();
+    QElapsedTimer timer;
+    timer.start();
+    result.ok = parallel ? util.startParallelLexAnalyze() : util.startLexAnalyze();
+    result.elapsedNs = timer.nsecsElapsed();
+    result.allocs = allocCount.load() - allocBase;
+    result.peakRssKb = peakRssKb();
+    result.tokens = util.getSymbolNum();
+    if(!result.ok) { result.errMsg = util.getErrorMsg(); }
+    return result;
+}
+
+/**
+ * @brief runIncrementalLexAnalyze 测量增量词法分析
+ * @details 完整分析后在随机选取的空格处再插入一个空格，然后删除，这样的编辑不会使源码出错，
+ *  耗时与内存分配次数为单次编辑的平均值，MB/s 为与完整分析对比的等效吞吐量
+ * @param src 预处理结果
+ * @return 测量结果
+ */
+StageResult runIncrementalLexAnalyze(const QByteArray & src)
+{
+    const int editNum = 1000;
+    StageResult result;
+    result.inputBytes = src.size();
+    LexAnalyzer util;
+    util.setSrc(src);
+    util.initUtil();
+    if(!util.startLexAnalyze()) {
+        result.ok = false;
+        result.errMsg = util.getErrorMsg();
+        return result;
+    }
+    Random random(7);
+    resetPeakRss();
+    quint64 allocBase = allocCount.load();
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < editNum && result.ok; i++) {
+        qsizetype position = util.getSrc().indexOf(' ', qsizetype(random.next(1u << 20)) * src.size() >> 20);
+        if(position < 0) { position = src.size(); }
+        result.ok = util.startIncrementalLexAnalyze(position, 0, QByteArray(" "))
+                && util.startIncrementalLexAnalyze(position, 1, QByteArray());
+    }
+    result.elapsedNs = timer.nsecsElapsed() / (2 * editNum);
+    result.allocs = (allocCount.load() - allocBase) / (2 * editNum);
+    result.peakRssKb = peakRssKb();
+    result.tokens = util.getSymbolNum();
+    if(!result.ok) { result.errMsg = util.getErrorMsg(); }
+    return result;
+}
+
+/**
+ * @brief runFusedAnalyze 测量一次预处理与词法分析同步进行的完整流程
+ * @param src 语料
+ * @param pipelined 是否使用三线程流水线
+ * @return 测量结果
+ */
+StageResult runFusedAnalyze(const QByteArray & src, bool pipelined)
+{
+    StageResult result;
+    result.inputBytes = src.size();
+    LexAnalyzer util;
+    util.setSrc(src);
+    resetPeakRss();
+    quint64 allocBase = allocCount.load();
+    QElapsedTimer timer;
+    timer.start();
+    result.ok = pipelined ? util.startPipelinedAnalyze() : util.startFusedAnalyze();
+    result.elapsedNs = timer.nsecsElapsed();
+    result.allocs = allocCount.load() - allocBase;
+    result.peakRssKb = peakRssKb();
+    result.tokens = util.getSymbolNum();
+    if(!result.ok) { result.errMsg = util.getErrorMsg(); }
+    return result;
+}
+
+/**
+ * @brief formatSize 以 KB/MB/GB 格式化字节数
+ */
+QString formatSize(qint64 bytes)
+{
+    if(bytes >= (qint64(1) << 30)) { return QString::number(bytes >> 30) + "G"; }
+    if(bytes >= (qint64(1) << 20)) { return QString::number(bytes >> 20) + "M"; }
+    return QString::number(bytes >> 10) + "K";
+}
+
+/**
+ * @brief printResult 输出一行测量结果
+ * @param out 输出流
+ * @param stage 阶段名称
+ * @param size 语料规模
+ * @param result 测量结果
+ * @param csv 是否以 CSV 格式输出
+ */
+void printResult(QTextStream & out, const QString & stage, qint64 size,
+                 const StageResult & result, bool csv)
+{
+    double seconds = qMax<double>(result.elapsedNs, 1) / 1e9;
+    double mbps = result.inputBytes / seconds / (1024.0 * 1024.0);
+    QString tokensPerSec = result.tokens < 0 ? QString("-")
+                                             : QString::number(qint64(result.tokens / seconds));
+    QString rss = result.peakRssKb < 0 ? QString("-")
+                                       : QString::number(result.peakRssKb / 1024.0, 'f', 1);
+    if(csv) {
+        out << stage << ',' << size << ',' << result.elapsedNs << ','
+            << QString::number(mbps, 'f', 3) << ',' << tokensPerSec << ','
+            << rss << ',' << result.allocs << ',' << (result.ok ? "ok" : "error") << Qt::endl;
+        return;
+    }
+    out << qSetFieldWidth(6) << Qt::left << stage << qSetFieldWidth(7) << formatSize(size)
+        << qSetFieldWidth(12) << Qt::right << QString::number(seconds * 1000.0, 'f', 2)
+        << QString::number(mbps, 'f', 2) << tokensPerSec << rss
+        << QString::number(result.allocs) << qSetFieldWidth(0);
+    if(!result.ok) { out << "  error: " << result.errMsg; }
+    out << Qt::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("lex_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("预处理与词法分析吞吐量基准");
+    parser.addHelpOption();
+    QCommandLineOption minOption("min", "最小语料规模(KB)", "kb", "1");
+    QCommandLineOption maxOption("max", "最大语料规模(KB)", "kb", "1048576");
+    QCommandLineOption factorOption("factor", "相邻两级语料规模的倍数", "n", "4");
+    QCommandLineOption budgetOption("budget", "任一阶段耗时超过该秒数后不再扩大规模", "sec", "30");
+    QCommandLineOption macroOption("macros", "语料中定义的宏数量", "n", "64");
+    QCommandLineOption stageOption("stages", "需要测量的阶段", "list", "pre,macro,lex");
+    QCommandLineOption csvOption("csv", "以 CSV 格式输出结果");
+    parser.addOptions({ minOption, maxOption, factorOption, budgetOption,
+                        macroOption, stageOption, csvOption });
+    parser.process(app);
+
+    const qint64 minSize = qMax<qint64>(1, parser.value(minOption).toLongLong()) * 1024;
+    const qint64 maxSize = qMax<qint64>(1, parser.value(maxOption).toLongLong()) * 1024;
+    const qint64 factor = qMax<qint64>(2, parser.value(factorOption).toLongLong());
+    const qint64 budgetNs = qMax<qint64>(1, parser.value(budgetOption).toLongLong()) * 1000000000;
+    const int macroNum = qMax(1, parser.value(macroOption).toInt());
+    const QStringList stages = parser.value(stageOption).split(',');
+    const bool csv = parser.isSet(csvOption);
+
+    QTemporaryDir tempDir;
+    if(!tempDir.isValid()) {
+        QTextStream(stderr) << "无法创建临时目录" << Qt::endl;
+        return 1;
+    }
+    QString headerPath = tempDir.filePath("bench_header.h");
+    QFile header(headerPath);
+    if(!header.open(QIODevice::WriteOnly) || header.write(buildHeader(macroNum)) < 0) {
+        QTextStream(stderr) << "无法写入头文件 " << headerPath << Qt::endl;
+        return 1;
+    }
+    header.close();
+
+    QTextStream out(stdout);
+    if(csv) {
+        out << "stage,size,ns,mb_per_s,tokens_per_s,peak_rss_mb,allocs,status" << Qt::endl;
+    } else {
+        out << "simd: " << ByteScan::levelName() << Qt::endl;
+        out << qSetFieldWidth(6) << Qt::left << "stage" << qSetFieldWidth(7) << "size"
+            << qSetFieldWidth(12) << Qt::right << "time(ms)" << "MB/s" << "tokens/s"
+            << "peakRSS(MB)" << "allocs" << qSetFieldWidth(0) << Qt::endl;
+    }
+
+    for(qint64 size = minSize; size <= maxSize; size *= factor) {
+        qint64 slowest = 0;
+        QByteArray preprocessed;
+        if(stages.contains("pre") || stages.contains("lex") || stages.contains("plex")
+                || stages.contains("incr")) {
+            preprocessed = buildCorpus(size, headerPath, macroNum);
+            StageResult result = runPreProcess(preprocessed);
+            if(stages.contains("pre")) { printResult(out, "pre", size, result, csv); }
+            slowest = qMax(slowest, result.elapsedNs);
+            if(!result.ok) { preprocessed.clear(); }
+        }
+        for(const QString & stage : { QString("fused"), QString("pipe") }) {
+            if(!stages.contains(stage)) { continue; }
+            QByteArray src = buildCorpus(size, headerPath, macroNum);
+            StageResult result = runFusedAnalyze(src, stage == "pipe");
+            printResult(out, stage, size, result, csv);
+            slowest = qMax(slowest, result.elapsedNs);
+        }
+        if(stages.contains("macro")) {
+            QByteArray src = buildMacroCorpus(size, macroNum);
+            StageResult result = runPreProcess(src);
+            printResult(out, "macro", size, result, csv);
+            slowest = qMax(slowest, result.elapsedNs);
+        }
+        for(const QString & stage : { QString("lex"), QString("plex"), QString("incr") }) {
+            if(!stages.contains(stage) || preprocessed.isEmpty()) { continue; }
+            StageResult result = stage == "incr" ? runIncrementalLexAnalyze(preprocessed)
+                                                 : runLexAnalyze(preprocessed, stage == "plex");
+            printResult(out, stage, size, result, csv);
+            slowest = qMax(slowest, result.elapsedNs);
+        }
+        if(slowest > budgetNs) { break; }
+    }
+    return 0;
+}
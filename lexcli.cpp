@@ -0,0 +1,334 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QHash>
+#include <QStringList>
+#include <QTextStream>
+
+#include <cstdio>
+#include <utility>
+
+#include "batchanalyzer.h"
+#include "lexanalyzer.h"
+#include "sourcefile.h"
+
+/**
+ * lexcli 无界面批处理词法分析工具
+ * 用法: lexcli [-E] [--pipeline | -j 线程数] [--workers 线程数] [-o 输出目录] [--ext c,h,txt] 文件或目录...
+ * 多个输入文件由批处理调度器在多个线程中同时执行预处理与词法分析，每行输出一个 Token，
+ * 结果按输入顺序写出
+ * 未指定输出目录时结果写到标准输出，有多个输入时每个输入的结果前写出 "# <路径>" 一行以便拆分；
+ * 否则按输入相对于所有输入公共上级目录的路径写入 "<文件名>.tok"，不同输入得到相同文件名时报错
+ * 路径 "-" 表示从标准输入流式读取已经预处理过的源码，边读边输出 Token，结果写入 "stdin.tok"
+ */
+
+namespace {
+
+struct CliOptions {
+    bool preProcessOnly = false;    // 仅输出预处理结果
+    bool pipelined = false;         // 以三线程流水线处理每个文件
+    int jobs = 0;                   // 预处理后分块并行词法分析的线程数，为 0 时不分块
+    int workers = 0;                // 同时处理的文件数，为 0 时自动选择
+    QString outputDir;              // 输出目录，为空时写到标准输出
+    bool labelOutputs = false;      // 写到标准输出时是否在每个输入的结果前写出 "# <路径>"
+    QStringList nameFilters;        // 目录扫描时的文件名过滤
+};
+
+struct InputFile {
+    QString path;                   // 输入文件绝对路径
+    QString outputName;             // 相对输出目录的结果文件名
+};
+
+/**
+ * @brief commonParent 求若干目录的公共上级目录
+ * @param dirs 绝对路径形式的目录
+ * @return 公共上级目录，没有时(如位于不同驱动器)为空
+ */
+QString commonParent(const QStringList & dirs)
+{
+    QStringList common = QDir::cleanPath(dirs.first()).split('/');
+    for(const QString & dir : dirs) {
+        QStringList parts = QDir::cleanPath(dir).split('/');
+        int same = 0;
+        while(same < common.size() && same < parts.size() && common.at(same) == parts.at(same)) { same++; }
+        common = common.mid(0, same);
+    }
+    if(common.isEmpty()) { return QString(); }
+    // 根目录拆分后为一个空串
+    return common.size() == 1 && common.first().isEmpty() ? QString("/") : common.join('/');
+}
+
+/**
+ * @brief collectInputs 展开命令行给出的文件与目录
+ * @param paths 命令行路径
+ * @param options 命令行选项
+ * @param inputs 带出的输入文件列表
+ * @param bases 带出每个命令行路径对应的目录: 文件所在目录或给出的目录
+ * @return 所有路径是否都存在
+ */
+bool collectInputs(const QStringList & paths, const CliOptions & options,
+                   QList<InputFile> & inputs, QStringList & bases)
+{
+    bool ok = true;
+    for(const QString & path : paths) {
+        QFileInfo info(path);
+        if(info.isFile()) {
+            inputs.append(InputFile{ info.absoluteFilePath(), QString() });
+            bases.append(info.absolutePath());
+        } else if(info.isDir()) {
+            QDir root(info.absoluteFilePath());
+            QStringList found;
+            QDirIterator iter(root.absolutePath(), options.nameFilters,
+                              QDir::Files, QDirIterator::Subdirectories);
+            while(iter.hasNext()) { found.append(iter.next()); }
+            // 保证输出顺序与文件系统遍历顺序无关
+            found.sort();
+            for(const QString & file : found) {
+                inputs.append(InputFile{ file, QString() });
+            }
+            bases.append(root.absolutePath());
+        } else {
+            QTextStream(stderr) << path << ": 文件不存在" << Qt::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief assignOutputNames 为每个输入确定结果文件名
+ * @details 结果文件名取输入相对于所有命令行路径公共上级目录的路径，单个文件即为文件名，
+ *  单个目录即为目录内的相对路径，不同位置的同名文件因此不会写到同一结果文件；
+ *  同一文件被多次给出时结果文件名仍会相同，写入输出目录前报错
+ * @param inputs 输入文件列表
+ * @param bases 每个命令行路径对应的目录
+ * @param options 命令行选项
+ * @param useStdin 是否同时分析标准输入，其结果文件名为 "stdin"
+ * @return 写入输出目录时结果文件名是否互不相同
+ */
+bool assignOutputNames(QList<InputFile> & inputs, const QStringList & bases,
+                       const CliOptions & options, bool useStdin)
+{
+    if(inputs.isEmpty()) { return true; }
+    QString parent = commonParent(bases);
+    bool ok = true;
+    QHash<QString, QString> owners;     // 结果文件名到输入路径
+    if(useStdin) { owners.insert("stdin", "-"); }
+    for(InputFile & input : inputs) {
+        if(!parent.isEmpty()) {
+            input.outputName = QDir(parent).relativeFilePath(input.path);
+        } else {
+            // 没有公共上级目录时去掉盘符中的冒号与开头的斜杠，结果仍位于输出目录内
+            input.outputName = QString(input.path).remove(':');
+            while(input.outputName.startsWith('/')) { input.outputName.remove(0, 1); }
+        }
+        if(options.outputDir.isEmpty()) { continue; }
+        QString owner = owners.value(input.outputName);
+        if(!owner.isEmpty()) {
+            QTextStream(stderr) << input.path << ": 结果文件 " << input.outputName
+                                << " 与 " << owner << " 相同" << Qt::endl;
+            ok = false;
+        }
+        owners.insert(input.outputName, input.path);
+    }
+    return ok;
+}
+
+/**
+ * @brief analyzeFile 在批处理工作线程中对单个文件执行预处理与词法分析
+ * @param util 本线程的词法分析器
+ * @param file 源码文件
+ * @param options 命令行选项
+ * @param result 带出的输出文本
+ * @return 是否处理成功
+ */
+bool analyzeFile(LexAnalyzer & util, const SourceFile & file,
+                 const CliOptions & options, QByteArray & result)
+{
+    if(options.preProcessOnly) {
+        if(!util.startPreProcess(file)) { return false; }
+        result = util.getSrc();
+        result.push_back('\n');
+        return true;
+    }
+    bool ok;
+    if(options.jobs > 0) {
+        // 分块需要完整的预处理结果
+        ok = util.startPreProcess(file) && util.startParallelLexAnalyze(options.jobs);
+    } else {
+        // 预处理结果直接送入词法分析，不生成完整的预处理文本
+        ok = options.pipelined ? util.startPipelinedAnalyze(file) : util.startFusedAnalyze(file);
+    }
+    if(!ok) { return false; }
+    result.clear();
+    const TokenBuffer & tokens = util.getTokens();
+    for(int i = 0; i < tokens.size(); i++) {
+        tokens.appendText(i, result);
+        result.push_back('\n');
+    }
+    return true;
+}
+
+/**
+ * @brief openOutput 打开结果输出文件
+ * @param file 带出的输出文件
+ * @param options 命令行选项
+ * @param name 相对输出目录的结果文件名
+ * @return 是否成功打开
+ */
+bool openOutput(QFile & file, const CliOptions & options, const QString & name)
+{
+    if(options.outputDir.isEmpty()) {
+        return file.open(stdout, QIODevice::WriteOnly);
+    }
+    QFileInfo target(QDir(options.outputDir).filePath(name));
+    if(!QDir().mkpath(target.absolutePath())) { return false; }
+    file.setFileName(target.absoluteFilePath());
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+}
+
+/**
+ * @brief analyzeStream 从标准输入流式读取源码并逐个输出 Token
+ * @details 不保存完整的输入与 Token 表，适合分析管道传入的大体积预处理结果
+ * @param util 词法分析器
+ * @param options 命令行选项
+ * @return 是否处理成功
+ */
+bool analyzeStream(LexAnalyzer & util, const CliOptions & options)
+{
+    if(options.preProcessOnly) {
+        QTextStream(stderr) << "-: 标准输入不经过预处理，不能与 -E 同时使用" << Qt::endl;
+        return false;
+    }
+    QFile output;
+    if(!util.setInput(fileno(stdin)) || !openOutput(output, options, "stdin.tok")) {
+        QTextStream(stderr) << "-: 无法打开输入或输出" << Qt::endl;
+        return false;
+    }
+    util.initUtil();
+    QByteArray result;
+    if(options.labelOutputs) { result = "# -\n"; }
+    int status = 0;
+    while((status = util.lexNextToken()) == 1) {
+        util.getTokens().appendText(0, result);
+        result.push_back('\n');
+        // 攒够一定数量再写出，减少系统调用
+        if(result.size() >= 64 * 1024) {
+            output.write(result);
+            result.truncate(0);
+        }
+    }
+    output.write(result);
+    if(status < 0) {
+        QTextStream(stderr) << "-: " << util.getErrorMsg() << Qt::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief writeResult 输出分析结果
+ * @param input 输入文件
+ * @param options 命令行选项
+ * @param result 输出文本
+ * @return 是否写出成功
+ */
+bool writeResult(const InputFile & input, const CliOptions & options, const QByteArray & result)
+{
+    QFile file;
+    QString suffix = options.preProcessOnly ? ".i" : ".tok";
+    if(!openOutput(file, options, input.outputName + suffix)) { return false; }
+    if(options.labelOutputs && file.write("# " + input.path.toUtf8() + "\n") < 0) { return false; }
+    return file.write(result) >= 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("lexcli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("类C词法分析器批处理工具");
+    parser.addHelpOption();
+    QCommandLineOption preOption(QStringList() << "E" << "preprocess",
+                                 "仅执行预处理并输出预处理结果");
+    QCommandLineOption outOption(QStringList() << "o" << "output",
+                                 "结果输出目录，默认写到标准输出", "dir");
+    QCommandLineOption extOption("ext", "扫描目录时处理的扩展名，以逗号分隔",
+                                 "list", "c,h,txt");
+    QCommandLineOption pipeOption("pipeline",
+                                  "预处理、词法识别与查表登记分别在三个线程中流水进行，适合单个较大的文件");
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs",
+                                  "预处理后将源码分块，以指定数量的线程并行词法分析，适合单个很大的文件",
+                                  "n");
+    parser.addOption(preOption);
+    parser.addOption(pipeOption);
+    QCommandLineOption workersOption("workers",
+                                     "同时处理的文件数，默认为处理器核数，指定 --pipeline 或 -j 时默认为 1",
+                                     "n");
+    parser.addOption(jobsOption);
+    parser.addOption(workersOption);
+    parser.addOption(outOption);
+    parser.addOption(extOption);
+    parser.addPositionalArgument("paths", "需要分析的文件或目录", "paths...");
+    parser.process(app);
+
+    QStringList paths = parser.positionalArguments();
+    if(paths.isEmpty()) {
+        parser.showHelp(1);
+    }
+    // 标准输入不经过预处理，单独按流式处理
+    bool useStdin = paths.removeAll("-") > 0;
+
+    CliOptions options;
+    options.preProcessOnly = parser.isSet(preOption);
+    options.pipelined = parser.isSet(pipeOption);
+    options.jobs = qMax(0, parser.value(jobsOption).toInt());
+    options.workers = qMax(0, parser.value(workersOption).toInt());
+    if(options.workers == 0 && (options.pipelined || options.jobs > 0)) {
+        // 单个文件已经使用多个线程
+        options.workers = 1;
+    }
+    options.outputDir = parser.value(outOption);
+    for(const QString & ext : parser.value(extOption).split(',')) {
+        if(!ext.trimmed().isEmpty()) { options.nameFilters.append("*." + ext.trimmed()); }
+    }
+
+    QList<InputFile> inputs;
+    QStringList bases;
+    bool ok = collectInputs(paths, options, inputs, bases);
+    if(!assignOutputNames(inputs, bases, options, useStdin)) {
+        // 否则后写出的结果会覆盖先写出的结果
+        return 1;
+    }
+    // 多个输入的结果依次写到标准输出时需要能够拆分
+    options.labelOutputs = options.outputDir.isEmpty() && inputs.size() + (useStdin ? 1 : 0) > 1;
+
+    LexAnalyzer util;
+    if(useStdin && !analyzeStream(util, options)) {
+        ok = false;
+    }
+    QStringList inputPaths;
+    for(const InputFile & input : std::as_const(inputs)) { inputPaths.append(input.path); }
+    BatchAnalyzer batch;
+    batch.setThreadCount(options.workers);
+    auto task = [&options](LexAnalyzer & analyzer, const SourceFile & file, QByteArray & result) {
+        return analyzeFile(analyzer, file, options, result);
+    };
+    auto handler = [&](int index, BatchAnalyzer::FileResult & result) {
+        const InputFile & input = inputs.at(index);
+        if(!result.ok) {
+            QTextStream(stderr) << input.path << ": " << result.errorMsg << Qt::endl;
+            ok = false;
+        } else if(!writeResult(input, options, result.output)) {
+            QTextStream(stderr) << input.path << ": 无法写出结果" << Qt::endl;
+            ok = false;
+        }
+    };
+    batch.run(inputPaths, task, handler);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,288 @@
+#ifndef LEXTABLE_H
+#define LEXTABLE_H
+
+#include <QtGlobal>
+
+/**
+ * @brief 词法分析状态机表
+ * @details 字符类别表与状态转移表均在编译期生成
+ *  词法分析时每读入一个字节只需查表两次：先查字节所属类别，再查下一状态
+ *  状态编号小于 StateNonFinal 的为中间状态，其余为终止状态
+ */
+namespace LexTable {
+
+/**
+ * @brief 字符类别
+ */
+enum CharClass : quint8 {
+    ClassOther = 0,     // 无法识别的字符
+    ClassSpace,         // 空白字符
+    ClassLetter,        // 字母与下划线
+    ClassDigit,         // 数字
+    ClassDot,           // 小数点
+    ClassQuote,         // 双引号
+    ClassEnd,           // 源码结束标志 '\0'
+    ClassEqual,         // '='
+    ClassLess,          // '<'
+    ClassGreater,       // '>'
+    ClassBang,          // '!'
+    ClassSingle,        // 只能单独构成操作符的字符
+    ClassCount
+};
+
+/**
+ * @brief 状态机状态
+ */
+enum State : quint8 {
+    // 中间状态
+    StateStart = 0,     // 初始状态
+    StateId,            // 标识符或关键字
+    StateNumber,        // 整数或浮点数
+    StateString,        // 字符串常量
+    StateEqual,         // 已读入 '='
+    StateLess,          // 已读入 '<'
+    StateGreater,       // 已读入 '>'
+    StateBang,          // 已读入 '!'
+    StateNonFinal,
+    // 终止状态，带有 Back 的状态最后读入的字节不属于该词法单元
+    AcceptIdBack = StateNonFinal,
+    AcceptNumberBack,
+    AcceptString,
+    AcceptOperator,
+    AcceptOperatorBack,
+    AcceptEnd,
+    ErrorChar,
+    ErrorString
+};
+
+struct ClassTable {
+    quint8 value[256];
+};
+
+struct TransitionTable {
+    quint8 next[StateNonFinal][ClassCount];
+};
+
+constexpr ClassTable makeClassTable()
+{
+    ClassTable table = {};
+    for(int ch = 'a'; ch <= 'z'; ch++) { table.value[ch] = ClassLetter; }
+    for(int ch = 'A'; ch <= 'Z'; ch++) { table.value[ch] = ClassLetter; }
+    for(int ch = '0'; ch <= '9'; ch++) { table.value[ch] = ClassDigit; }
+    table.value[int('_')] = ClassLetter;
+    table.value[int(' ')] = ClassSpace;
+    table.value[int('\t')] = ClassSpace;
+    table.value[int('\r')] = ClassSpace;
+    table.value[int('\n')] = ClassSpace;
+    table.value[int('.')] = ClassDot;
+    table.value[int('"')] = ClassQuote;
+    table.value[0] = ClassEnd;
+    table.value[int('=')] = ClassEqual;
+    table.value[int('<')] = ClassLess;
+    table.value[int('>')] = ClassGreater;
+    table.value[int('!')] = ClassBang;
+    const char singles[] = "+-*/%&|;,(){}[]:";
+    for(int i = 0; singles[i] != 0; i++) { table.value[int(singles[i])] = ClassSingle; }
+    return table;
+}
+
+constexpr TransitionTable makeTransitionTable()
+{
+    TransitionTable table = {};
+    for(int cls = 0; cls < ClassCount; cls++) {
+        table.next[StateStart][cls] = ErrorChar;
+        table.next[StateId][cls] = AcceptIdBack;
+        table.next[StateNumber][cls] = AcceptNumberBack;
+        table.next[StateString][cls] = StateString;
+        table.next[StateEqual][cls] = AcceptOperatorBack;
+        table.next[StateLess][cls] = AcceptOperatorBack;
+        table.next[StateGreater][cls] = AcceptOperatorBack;
+        table.next[StateBang][cls] = AcceptOperatorBack;
+    }
+    table.next[StateStart][ClassSpace] = StateStart;
+    table.next[StateStart][ClassLetter] = StateId;
+    table.next[StateStart][ClassDigit] = StateNumber;
+    table.next[StateStart][ClassQuote] = StateString;
+    table.next[StateStart][ClassEnd] = AcceptEnd;
+    table.next[StateStart][ClassEqual] = StateEqual;
+    table.next[StateStart][ClassLess] = StateLess;
+    table.next[StateStart][ClassGreater] = StateGreater;
+    table.next[StateStart][ClassBang] = StateBang;
+    table.next[StateStart][ClassSingle] = AcceptOperator;
+
+    table.next[StateId][ClassLetter] = StateId;
+    table.next[StateId][ClassDigit] = StateId;
+
+    table.next[StateNumber][ClassDigit] = StateNumber;
+    table.next[StateNumber][ClassDot] = StateNumber;
+
+    table.next[StateString][ClassQuote] = AcceptString;
+    table.next[StateString][ClassEnd] = ErrorString;
+
+    // "==" ">=" "<=" "!=" 为仅有的双字符操作符
+    table.next[StateEqual][ClassEqual] = AcceptOperator;
+    table.next[StateLess][ClassEqual] = AcceptOperator;
+    table.next[StateGreater][ClassEqual] = AcceptOperator;
+    table.next[StateBang][ClassEqual] = AcceptOperator;
+    return table;
+}
+
+constexpr ClassTable charClass = makeClassTable();
+constexpr TransitionTable transition = makeTransitionTable();
+
+/**
+ * @brief isFinal 是否为终止状态
+ */
+constexpr bool isFinal(quint8 state)
+{
+    return state >= StateNonFinal;
+}
+
+/**
+ * @brief 操作符，顺序与词法单元表一致
+ */
+enum Operator : quint8 {
+    OpAssign = 0, OpPlus, OpSub, OpMul, OpDiv, OpMod, OpEq, OpGre, OpGeq, OpLes, OpLeq,
+    OpNeq, OpAnd, OpOr, OpNot, OpSmc, OpCma, OpLpar, OpRpar, OpLbrc, OpRbrc, OpLsbrc,
+    OpRsbrc, OpColon,
+    OperatorCount,
+    OpNone = OperatorCount
+};
+
+/**
+ * @brief 操作符助记符名称
+ */
+constexpr const char *operatorName[OperatorCount] = {
+    "assign", "plus", "sub", "mul", "div", "mod", "eq", "gre", "geq", "les", "leq",
+    "neq", "and", "or", "not", "smc", "cma", "lpar", "rpar", "lbrc", "rbrc", "lsbrc",
+    "rsbrc", "colon"
+};
+
+/**
+ * @brief findOperator 按首字节与次字节直接确定操作符
+ * @param text 操作符起始指针
+ * @param length 操作符字节数
+ * @return 操作符，不是操作符时返回 OpNone
+ */
+constexpr Operator findOperator(const char *text, int length)
+{
+    if(length == 2) {
+        if(text[1] != '=') { return OpNone; }
+        switch (text[0]) {
+        case '=': return OpEq;
+        case '>': return OpGeq;
+        case '<': return OpLeq;
+        case '!': return OpNeq;
+        default: return OpNone;
+        }
+    }
+    if(length != 1) { return OpNone; }
+    switch (text[0]) {
+    case '=': return OpAssign;
+    case '+': return OpPlus;
+    case '-': return OpSub;
+    case '*': return OpMul;
+    case '/': return OpDiv;
+    case '%': return OpMod;
+    case '>': return OpGre;
+    case '<': return OpLes;
+    case '&': return OpAnd;
+    case '|': return OpOr;
+    case '!': return OpNot;
+    case ';': return OpSmc;
+    case ',': return OpCma;
+    case '(': return OpLpar;
+    case ')': return OpRpar;
+    case '{': return OpLbrc;
+    case '}': return OpRbrc;
+    case '[': return OpLsbrc;
+    case ']': return OpRsbrc;
+    case ':': return OpColon;
+    default: return OpNone;
+    }
+}
+
+/**
+ * @brief 关键字，顺序与词法单元表一致
+ */
+enum Keyword : quint8 {
+    KwVoid = 0, KwInt, KwLong, KwFloat, KwDouble, KwBool, KwString, KwIf, KwElif, KwElse,
+    KwReturn, KwWhile, KwFor, KwBreak, KwContinue, KwSwitch, KwCase, KwDefault, KwTrue,
+    KwFalse,
+    KeywordCount,
+    KwNone = KeywordCount
+};
+
+/**
+ * @brief 关键字文本
+ */
+constexpr const char *keywordName[KeywordCount] = {
+    "void", "int", "long", "float", "double",
+    "bool", "string", "if", "elif", "else", "return",
+    "while", "for", "break", "continue", "switch",
+    "case", "default", "true", "false"
+};
+
+constexpr int KeywordSlotCount = 32;    // 哈希表槽位数
+constexpr int KeywordMaxLength = 8;     // 最长关键字字节数
+
+/**
+ * @brief keywordHash 关键字完美哈希函数
+ * @details 由首字节、末字节与长度计算槽位，系数经过挑选使全部关键字互不冲突
+ */
+constexpr int keywordHash(const char *text, int length)
+{
+    return int((uchar(text[0]) * 11u + uchar(text[length - 1]) + uint(length) * 3u)
+               & uint(KeywordSlotCount - 1));
+}
+
+constexpr int nameLength(const char *text)
+{
+    int length = 0;
+    while(text[length] != 0) { length++; }
+    return length;
+}
+
+struct KeywordTable {
+    quint8 slot[KeywordSlotCount];
+    bool isPerfect;
+};
+
+constexpr KeywordTable makeKeywordTable()
+{
+    KeywordTable table = {};
+    table.isPerfect = true;
+    for(int i = 0; i < KeywordSlotCount; i++) { table.slot[i] = KwNone; }
+    for(int kw = 0; kw < KeywordCount; kw++) {
+        int hash = keywordHash(keywordName[kw], nameLength(keywordName[kw]));
+        if(table.slot[hash] != KwNone) { table.isPerfect = false; }
+        table.slot[hash] = quint8(kw);
+    }
+    return table;
+}
+
+constexpr KeywordTable keywordTable = makeKeywordTable();
+static_assert(keywordTable.isPerfect, "keywordHash 存在冲突，需要重新挑选系数");
+
+/**
+ * @brief findKeyword 查找标识符是否为关键字
+ * @details 一次哈希定位槽位，再逐字节比较确认，不分配内存
+ * @param text 标识符起始指针
+ * @param length 标识符字节数
+ * @return 关键字，不是关键字时返回 KwNone
+ */
+inline Keyword findKeyword(const char *text, int length)
+{
+    if(length < 2 || length > KeywordMaxLength) { return KwNone; }
+    quint8 kw = keywordTable.slot[keywordHash(text, length)];
+    if(kw == KwNone) { return KwNone; }
+    const char *name = keywordName[kw];
+    for(int i = 0; i < length; i++) {
+        if(name[i] != text[i]) { return KwNone; }
+    }
+    return name[length] == 0 ? Keyword(kw) : KwNone;
+}
+
+} // namespace LexTable
+
+#endif // LEXTABLE_H
@@ -1,18 +1,29 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
 
+#include <QThreadPool>
+#include <QtConcurrent>
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , util(new LexAnalyzer())
+    , includeCache(new IncludeCache)
+    , tokenModel(new TokenTableModel(this))
 {
     ui->setupUi(this);
-    util = new LexAnalyzer();
+    // 视图只为可见的行向模型请求文本
+    ui->resultTable->setModel(tokenModel);
+    ui->resultTable->setColumnWidth(0, 180);
+    setJobRunning(false);
     on_srcTextEdit_textChanged();
 }
 
 MainWindow::~MainWindow()
 {
-    delete util;
+    // 后台任务通过 this 送回进度，析构前等待其结束
+    cancelJob();
+    QThreadPool::globalInstance()->waitForDone();
     delete ui;
 }
 
@@ -20,6 +31,7 @@ MainWindow::~MainWindow()
 void MainWindow::on_srcHeaderFileBtn_clicked()
 {
     QString text = openTextFile(this);
+    isLive = false;
     ui->srcTextEdit->setPlainText(text);
 }
 
@@ -27,7 +39,7 @@ void MainWindow::on_srcHeaderFileBtn_clicked()
 void MainWindow::on_srcHeaderSymbolBtn_clicked()
 {
     Form * form = new Form();
-    form->setLex(this->util);
+    form->setLex(this->util.data());
     form->init();
     form->setAttribute(Qt::WA_DeleteOnClose);
     form->setWindowFlag(Qt::Window, true);
@@ -44,52 +56,111 @@ QString MainWindow::openTextFile(QWidget* widget)
     if(filename.isEmpty()) {
         return QString();
     }
-     QFile file(filename);
-    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    SourceFile file;
+    if(!file.open(filename)) {
         return QString();
     }
-    QTextStream stream(&file);
-    stream.setAutoDetectUnicode(true);
-    QString text = stream.readAll();
-    file.close();
-    return text;
+    return file.text();
 }
 
-void MainWindow::setFontPlat(QTableWidgetItem *item, int size, bool isBold)
+void MainWindow::resetTable()
 {
-    QFont font = item->font();
-    font.setBold(isBold);
-    font.setPointSize(size);
-    item->setForeground(Qt::black);
-    item->setTextAlignment(Qt::AlignHCenter | Qt::AlignVCenter);
-    item->setFont(font);
+    tokenModel->setTokens(nullptr);
 }
 
-void MainWindow::setTableScale(int num) {
-    ui->resultTable->clear();
-    ui->resultTable->setColumnCount(1);
-    ui->resultTable->setColumnWidth(0, 180);
-    ui->resultTable->setRowCount(num);
-    QTableWidgetItem * item = new QTableWidgetItem("语法单元");
-    setFontPlat(item, 11, true);
-    ui->resultTable->setHorizontalHeaderItem(0, item);
+void MainWindow::fillAnalyTable()
+{
+    tokenModel->setTokens(&util->getTokens());
 }
 
-void MainWindow::resetTable()
+void MainWindow::startJob(const QByteArray &src, bool isStreaming, const JobTask &task, const JobHandler &handler)
+{
+    cancelJob();
+    QSharedPointer<AnalysisJob> job(new AnalysisJob);
+    job->util.reset(new LexAnalyzer());
+    job->util->setIncludeCache(includeCache);
+    job->util->setSrc(src);
+    // 回调保存在任务的分析器中，只持有任务的弱引用
+    AnalysisJob * worker = job.data();
+    QWeakPointer<AnalysisJob> weakJob = job;
+    job->util->setProgressHandler([this, worker, weakJob, isStreaming](qsizetype done, qsizetype total) {
+        if(worker->isCanceled) { return false; }
+        // 词法分析任务新识别出的 Token 随进度一起送往界面线程，预处理任务只报告进度
+        TokenBuffer batch;
+        if(isStreaming) {
+            const TokenBuffer & tokens = worker->util->getTokens();
+            batch.append(tokens, worker->sentTokens, tokens.size() - worker->sentTokens);
+            worker->sentTokens = tokens.size();
+        }
+        QMetaObject::invokeMethod(this, [this, weakJob, batch, done, total]() {
+            if(weakJob.toStrongRef() != currentJob) { return; }
+            if(batch.size() > 0) { tokenModel->appendTokens(batch); }
+            showProgress(done, total);
+        }, Qt::QueuedConnection);
+        return true;
+    });
+
+    currentJob = job;
+    setJobRunning(true);
+    QFutureWatcher<bool> * watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, job, handler]() {
+        watcher->deleteLater();
+        // 已取消或被新任务替代的任务不再影响界面
+        if(job != currentJob) { return; }
+        currentJob.reset();
+        setJobRunning(false);
+        job->util->setProgressHandler(LexAnalyzer::ProgressHandler());
+        handler(watcher->result(), job->util);
+    });
+    watcher->setFuture(QtConcurrent::run([job, task]() { return task(*job->util); }));
+}
+
+void MainWindow::startLexJob(const QByteArray &src)
+{
+    resetTable();
+    ui->srcHeaderSymbolBtn->setDisabled(true);
+    startJob(src, true, [](LexAnalyzer & worker) {
+        worker.initUtil();
+        return worker.startLexAnalyze();
+    }, [this](bool isLexed, const QSharedPointer<LexAnalyzer> & worker) {
+        // 出错时同样保留分析器，其源码与编辑框一致，之后的编辑据此重新分析
+        if(isLexed) {
+            util = worker;
+            // 表格改为引用分析器的 Token 表，只补上最后一次报告进度之后识别出的 Token
+            tokenModel->attachTokens(&util->getTokens());
+            ui->srcHeaderSymbolBtn->setDisabled(false);
+            // 之后的编辑只重新识别受影响的部分
+            isLive = true;
+        } else {
+            resetTable();
+            util = worker;
+            ui->srcHeaderWarning->setText(util->getErrorMsg());
+        }
+    });
+}
+
+void MainWindow::cancelJob()
+{
+    if(!currentJob) {
+        return;
+    }
+    // 后台线程在下一次报告进度时结束
+    currentJob->isCanceled = true;
+    currentJob.reset();
+    setJobRunning(false);
+}
+
+void MainWindow::setJobRunning(bool isRunning)
 {
-    ui->resultTable->clear();
-    ui->resultTable->setColumnCount(0);
-    ui->resultTable->setRowCount(0);
+    ui->resultProgressBar->setValue(0);
+    ui->resultProgressBar->setVisible(isRunning);
+    ui->resultCancelBtn->setDisabled(!isRunning);
 }
 
-void MainWindow::fillAnalyTable(QStringList::Iterator iter)
+void MainWindow::showProgress(qsizetype done, qsizetype total)
 {
-    int itemNum = util->getSymbolNum();
-    setTableScale(itemNum);
-    for(int i = 0; iter != util->getSymbolEnd(); i++, iter++) {
-        QTableWidgetItem * item = new QTableWidgetItem(*iter);
-        setFontPlat(item, 10, false);
-        ui->resultTable->setItem(i, 0, item);
+    if(total > 0) {
+        ui->resultProgressBar->setValue(int(done * 100 / total));
     }
 }
 
@@ -103,37 +174,70 @@ void MainWindow::on_resultPreProBtn_clicked()
                                  QMessageBox::Ok, QMessageBox::NoButton);
         return;
     }
-    util->setSrc(src);
-    if(util->startPreProcess()) {
-        src = util->getSrc();
-        ui->srcTextEdit->setPlainText(src);
+    startJob(src.toUtf8(), false, [](LexAnalyzer & worker) {
+        return worker.startPreProcess();
+    }, [this](bool isProcessed, const QSharedPointer<LexAnalyzer> & worker) {
+        if(!isProcessed) {
+            ui->srcHeaderWarning->setText(worker->getErrorMsg());
+            return;
+        }
+        // 表格引用原分析器的 Token 表，替换分析器之前先清空
+        resetTable();
+        util = worker;
+        isLive = false;
+        ui->srcTextEdit->setPlainText(QString::fromUtf8(util->getSrc()));
         ui->resultAnalyAllBtn->setDisabled(false);
-    } else {
-        ui->srcHeaderWarning->setText(util->getErrorMsg());
-    }
+    });
 }
 
 
 void MainWindow::on_resultAnalyAllBtn_clicked()
 {
     ui->srcHeaderWarning->clear();
-    QString src = ui->srcTextEdit->toPlainText();
-    util->setSrc(src);
-    util->initUtil();
-    QStringList::Iterator iter;
-    if(util->startLexAnalyze(iter)) {
-        fillAnalyTable(iter);
+    // 编辑框内容改变后该按钮不可用，或分析结果随编辑增量更新，
+    // 此时编辑框中的文本即为分析器保存的源码，无需再从编辑框取回并重新编码
+    startLexJob(util->getSrc());
+}
+
+
+void MainWindow::on_srcTextEdit_textChanged()
+{
+    // 编辑使正在执行的分析失效
+    cancelJob();
+    if(!isLive) {
+        ui->srcHeaderSymbolBtn->setDisabled(true);
+        ui->resultAnalyAllBtn->setDisabled(true);
+        resetTable();
+        return;
+    }
+    ui->srcHeaderWarning->clear();
+    QByteArray src = ui->srcTextEdit->toPlainText().toUtf8();
+    if(!util->isResultComplete()) {
+        // 上次分析出错，修改后的源码在后台整体重新分析
+        startLexJob(src);
+        return;
+    }
+    // 编辑框内容与分析器中的源码只差这次编辑，比较前后缀即可得到修改范围
+    if(util->startIncrementalLexAnalyze(src)) {
+        tokenModel->applyPatch(&util->getTokens(), util->getLastPatch());
         ui->srcHeaderSymbolBtn->setDisabled(false);
     } else {
+        // 出错后继续编辑时修改后的源码在后台整体重新分析
         ui->srcHeaderWarning->setText(util->getErrorMsg());
+        ui->srcHeaderSymbolBtn->setDisabled(true);
+        resetTable();
     }
 }
 
 
-void MainWindow::on_srcTextEdit_textChanged()
+void MainWindow::on_resultCancelBtn_clicked()
 {
-    ui->srcHeaderSymbolBtn->setDisabled(true);
-    ui->resultAnalyAllBtn->setDisabled(true);
-    resetTable();
+    cancelJob();
+    ui->srcHeaderWarning->setText("分析已取消");
+    // 取消的分析不影响界面之前展示的结果
+    if(isLive && util->isResultComplete()) {
+        fillAnalyTable();
+    } else {
+        resetTable();
+    }
 }
-
@@ -1,13 +1,18 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
-#include <QTableWidget>
+#include <atomic>
+#include <functional>
+
+#include <QFileDialog>
+#include <QFutureWatcher>
 #include <QMessageBox>
 #include <QMainWindow>
-#include <QTableWidgetItem>
+#include <QSharedPointer>
 
 #include "form.h"
 #include "lexanalyzer.h"
+#include "tokentablemodel.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -28,10 +33,26 @@ private slots:
     void on_resultPreProBtn_clicked();
     void on_resultAnalyAllBtn_clicked();
     void on_srcTextEdit_textChanged();
+    void on_resultCancelBtn_clicked();
 
 private:
+    /**
+     * @brief The AnalysisJob struct 在后台线程中执行的一次预处理或词法分析
+     */
+    struct AnalysisJob {
+        QSharedPointer<LexAnalyzer> util;       // 任务独占的分析器，结束后交给界面使用
+        std::atomic<bool> isCanceled{false};    // 是否已取消
+        int sentTokens = 0;                     // 已随进度送往界面的 Token 数，只在后台线程中访问
+    };
+    using JobTask = std::function<bool(LexAnalyzer &)>;
+    using JobHandler = std::function<void(bool, const QSharedPointer<LexAnalyzer> &)>;
+
     Ui::MainWindow *ui;
-    LexAnalyzer* util = nullptr;
+    QSharedPointer<LexAnalyzer> util;   // 界面当前展示的分析结果
+    QSharedPointer<IncludeCache> includeCache;  // 各次后台分析共用的包含文件缓存
+    QSharedPointer<AnalysisJob> currentJob;     // 正在执行的后台任务
+    TokenTableModel * tokenModel;   // 词法分析表的数据模型，引用 util 的 Token 表
+    bool isLive = false;    // 分析结果是否随编辑框内容增量更新
 
     /**
      * @brief openTextFile 打开指定文件
@@ -44,24 +65,39 @@ private:
      */
     void initTableHeader();
     /**
-     * @brief fillAnalyTable 填充词法分析表
-     * @param iter 分析结果起始迭代器
+     * @brief fillAnalyTable 按分析结果填充词法分析表
      */
-    void fillAnalyTable(QStringList::Iterator iter);
+    void fillAnalyTable();
 
     /**
-     * @brief setTableScale 设置表格规模
-     * @param item 表格组件指针
-     * @param coloum 列数
-     * @param row 行数
+     * @brief startJob 在后台线程中执行分析任务，之前未完成的任务被取消
+     * @details 任务使用独立的分析器，进度与新识别出的 Token 随时送回界面线程
+     * @param src 任务分析器的源码
+     * @param isStreaming 是否将新识别出的 Token 随进度填入表格，预处理任务为假，表格保持原有结果
+     * @param task 在后台线程中执行的任务
+     * @param handler 任务未被取消时在界面线程中接收结果与任务的分析器
      */
-    void setFontPlat(QTableWidgetItem *item, int size, bool isBold);
-
+    void startJob(const QByteArray & src, bool isStreaming, const JobTask & task, const JobHandler & handler);
+    /**
+     * @brief startLexJob 在后台线程中对给定源码全体词法分析，Token 随分析进度填入表格
+     * @param src 源码
+     */
+    void startLexJob(const QByteArray & src);
+    /**
+     * @brief cancelJob 取消正在执行的后台任务，不等待其结束
+     */
+    void cancelJob();
+    /**
+     * @brief setJobRunning 切换进度条与取消按钮的状态
+     * @param isRunning 是否有正在执行的后台任务
+     */
+    void setJobRunning(bool isRunning);
     /**
-     * @brief setTableScale 设置表格规模
-     * @param num Token 项数
+     * @brief showProgress 显示后台任务的进度
+     * @param done 已处理的字节数
+     * @param total 总字节数
      */
-    void setTableScale(int num);
+    void showProgress(qsizetype done, qsizetype total);
 
     /**
      * @brief resetTable 重置表格
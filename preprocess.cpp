@@ -1,325 +1,574 @@
 #include "preprocess.h"
 
-QMap<QString, QString> PreProcess::symbolMap;
+#include <cstring>
+#include <utility>
 
-PreProcess::PreProcess() {}
+#include <QThread>
 
-bool PreProcess::start(QString &src)
+#include "bytescan.h"
+
+PreProcess::PreProcess()
+    : includeCache(new IncludeCache)
 {
-    this->src = &src;
-    lexBase = 0;
-    lexForward = 0;
-    stateBase = 0;
+}
+
+PreProcess::PreProcess(const QSharedPointer<IncludeCache> &cache)
+    : includeCache(cache)
+{
+}
+
+bool PreProcess::start(QByteArray &src)
+{
+    QByteArray result;
+    if(!process(src.constData(), src.size(), QString(), result)) { return false; }
+    src.swap(result);
+    return true;
+}
+
+bool PreProcess::start(const SourceFile &file, QByteArray &result)
+{
+    return process(file.data(), file.size(), file.fileName(), result);
+}
+
+bool PreProcess::start(const SourceFile &file, const OutputSink &sink)
+{
+    return streamProcess(file.data(), file.size(), file.fileName(), sink);
+}
+
+bool PreProcess::start(const QByteArray &src, const OutputSink &sink)
+{
+    return streamProcess(src.constData(), src.size(), QString(), sink);
+}
+
+void PreProcess::initUnitState(const QString &filename)
+{
+    symbolMap.clear();
+    includedFiles.clear();
+    includeStack.clear();
+    if(!filename.isEmpty()) {
+        // 主文件同样参与循环包含检查
+        QString path = QFileInfo(filename).canonicalFilePath();
+        includedFiles.insert(path);
+        includeStack.append(path);
+    }
+}
+
+bool PreProcess::process(const char *data, qsizetype length, const QString &filename,
+                         QByteArray &result)
+{
+    initUnitState(filename);
     try {
-        mainRecognize();
+        PreProcessUnit unit;
+        recognizeUnit(data, length, unit);
+        if(unit.includes.isEmpty()) {
+            dst.swap(unit.text);
+            defineList.swap(unit.defines);
+        } else {
+            prefetchUnits(unit);
+            dst.clear();
+            dst.reserve(unit.text.size());
+            defineList.clear();
+            assembleUnit(unit);
+        }
     }  catch (QString & e) {
         errMsg = e;
+        dst.clear();
+        defineList.clear();
         return false;
     }
-    redressSymbol();
+    QByteArray recognized;
+    if(!defineList.isEmpty()) {
+        // 识别结果作为宏替换的数据源
+        recognized.swap(dst);
+        src = recognized.constData();
+        srcLength = recognized.size();
+        redressSymbol();
+    }
     trimSrc();
+    result.swap(dst);
+    dst.clear();
+    src = nullptr;
+    srcLength = 0;
     return true;
 }
 
+bool PreProcess::streamProcess(const char *data, qsizetype length, const QString &filename,
+                               const OutputSink &output)
+{
+    initUnitState(filename);
+    bool ok = true;
+    try {
+        PreProcessUnit unit;
+        recognizeUnit(data, length, unit);
+        prefetchUnits(unit);
+        // 宏定义在拼接到其所在位置时登记，拼接的同时完成替换
+        sink = &output;
+        dst.clear();
+        dst.reserve(SinkChunkLength * 2);
+        assembleUnit(unit);
+        flushSink(true);
+    }  catch (QString & e) {
+        errMsg = e;
+        ok = false;
+    }
+    sink = nullptr;
+    dst.clear();
+    src = nullptr;
+    srcLength = 0;
+    return ok;
+}
+
 const QString &PreProcess::getErrMsg() const
 {
     return errMsg;
 }
 
+void PreProcess::setIncludeDir(const QString &dir)
+{
+    includeDir = dir;
+}
+
+void PreProcess::clearIncludeCache()
+{
+    includeCache->clear();
+}
+
+void PreProcess::setIncludeCache(const QSharedPointer<IncludeCache> &cache)
+{
+    includeCache = cache;
+}
+
+void PreProcess::setProgressHandler(const ProgressHandler &handler)
+{
+    progressHandler = handler;
+}
+
 void PreProcess::mainRecognize()
 {
-    while(stateBase < src->length()) {
-        switch (src->at(stateBase).toLatin1()) {
+    dst.clear();
+    dst.reserve(srcLength);
+    stateBase = 0;
+    qsizetype progressMark = ProgressStep;
+    while(stateBase < srcLength) {
+        if(progressHandler && stateBase >= progressMark) {
+            if(!progressHandler(stateBase, srcLength)) { throw QString("处理已取消"); }
+            progressMark = stateBase + ProgressStep;
+        }
+        // 不需要处理的字符整段复制到输出
+        qsizetype runBase = stateBase;
+        stateBase = ByteScan::findSpecial(src + stateBase, src + srcLength) - src;
+        if(stateBase > runBase) { dst.append(src + runBase, stateBase - runBase); }
+        if(stateBase >= srcLength) { break; }
+
+        switch (src[stateBase]) {
         case '#':
             macroHandle();
-            scanBackspace();
             break;
         case '/':
             notationHandle();
-            scanBackspace();
             break;
         case ' ':
         case '\t':
         case '\r':
         case '\n':
-            whiteHandle(stateBase);
-            scanBackspace();
+            whiteHandle();
             break;
         case '"':
             scanJump();
-            scanBackspace();
             break;
         default:
-            if(src->at(stateBase).toLatin1() == 0) {
-            throw QString("无法识别的字符"); }
-            break;
+            throw QString("无法识别的字符");
         }
-        stateBase++;
     }
 }
 
-void PreProcess::recursiveFileProcess(QString & fileText)
+void PreProcess::recognizeUnit(const char *data, qsizetype length, PreProcessUnit &unit)
 {
-    PreProcess* processServer = new PreProcess();
+    src = data;
+    srcLength = length;
+    defineList.clear();
+    includeList.clear();
+    mainRecognize();
+    unit.text.swap(dst);
+    unit.defines.swap(defineList);
+    unit.includes.swap(includeList);
+    dst.clear();
+}
+
+void PreProcess::recursiveFileProcess(const SourceFile & file, PreProcessUnit & unit) const
+{
+    // 每个包含文件都构造一次，不为其分配只用一次的缓存
+    PreProcess processServer(includeCache);
     try {
-        processServer->recursiveFileRecognize(fileText);
-    }  catch (QString & e) {
-        delete processServer;
-        throw e;
-    }
-    if(processServer != nullptr) {
-        delete processServer;
-        processServer = nullptr;
+        processServer.recognizeUnit(file.data(), file.size(), unit);
+    } catch (QString & e) {
+        throw QFileInfo(file.fileName()).fileName() + ": " + e;
     }
 }
 
-void PreProcess::recursiveFileRecognize(QString &src)
+QSharedPointer<const PreProcessUnit> PreProcess::loadUnit(const QString &path, const QFileInfo &info)
 {
-    this->src = &src;
-    lexBase = 0;
-    lexForward = 0;
-    stateBase = 0;
-    mainRecognize();
+    QSharedPointer<const PreProcessUnit> cached = includeCache->find(path, info.lastModified(), info.size());
+    if(cached) { return cached; }
+
+    SourceFile file;
+    if(!file.open(path)) { throw QString("无法包含该文件"); }
+    QSharedPointer<PreProcessUnit> unit(new PreProcessUnit);
+    recursiveFileProcess(file, *unit);
+    includeCache->insert(path, info.lastModified(), info.size(), unit);
+    return unit;
 }
 
-void PreProcess::redressSymbol()
+QString PreProcess::resolveInclude(const QString &filename, QFileInfo &info) const
 {
-    for(auto mapIter = PreProcess::symbolMap.begin();
-        mapIter != PreProcess::symbolMap.end(); mapIter++) {
-        replaceSymbolInFile(mapIter.key(), mapIter.value());
-    }
+    if(filename.isEmpty()) { return QString(); }
+    info.setFile(QDir(includeDir).absoluteFilePath(filename));
+    return info.canonicalFilePath();
 }
 
-void PreProcess::trimSrc()
+void PreProcess::prefetchUnits(const PreProcessUnit &unit)
 {
-    int spaceCnt = 0;
-    for(int i = 0; i < src->length(); i++) {
-        if(src->at(i) == ' ') {spaceCnt++;}
-        else {break;}
-    }
-    src->remove(0, spaceCnt);
-    spaceCnt = 0;
-    for(int i = src->length() - 1; i >= 0; i--) {
-        if(src->at(i) == ' ') {spaceCnt++;}
-        else {break;}
+    QSet<QString> visited = includedFiles;
+    QVector<QSharedPointer<const PreProcessUnit>> holder;  // 保证遍历期间识别结果有效
+    QVector<const PreProcessUnit *> level;
+    level.append(&unit);
+    while(!level.isEmpty()) {
+        // 收集本层所有包含指令指向的文件，已缓存的直接进入下一层
+        QVector<const PreProcessUnit *> next;
+        QStringList paths;
+        QVector<QFileInfo> infos;
+        for(const PreProcessUnit * parent : std::as_const(level)) {
+            for(const IncludeDirective & include : parent->includes) {
+                QFileInfo info;
+                QString path = resolveInclude(include.filename, info);
+                if(path.isEmpty() || visited.contains(path)) { continue; }
+                visited.insert(path);
+                QSharedPointer<const PreProcessUnit> cached =
+                        includeCache->find(path, info.lastModified(), info.size());
+                if(cached) {
+                    holder.append(cached);
+                    next.append(cached.data());
+                } else {
+                    paths.append(path);
+                    infos.append(info);
+                }
+            }
+        }
+
+        QVector<QSharedPointer<const PreProcessUnit>> loaded(paths.size());
+        auto loadTask = [&](int index) {
+            try {
+                loaded[index] = loadUnit(paths.at(index), infos.at(index));
+            } catch (QString &) {
+                // 错误在顺序拼接时按包含顺序报告
+            }
+        };
+        if(paths.size() == 1) {
+            loadTask(0);
+        } else if(paths.size() > 1) {
+            QThreadPool pool;
+            pool.setMaxThreadCount(qMin(paths.size(), QThread::idealThreadCount()));
+            for(int index = 0; index < paths.size(); index++) {
+                pool.start([&loadTask, index]() { loadTask(index); });
+            }
+            pool.waitForDone();
+        }
+        for(const QSharedPointer<const PreProcessUnit> & child : std::as_const(loaded)) {
+            if(child) {
+                holder.append(child);
+                next.append(child.data());
+            }
+        }
+        level.swap(next);
     }
-    src->remove(src->length() - spaceCnt, spaceCnt);
 }
 
-QString PreProcess::getMacroName()
+void PreProcess::assembleUnit(const PreProcessUnit &unit)
 {
-    QString macro;
-    lexForward = lexBase;
-    // Get macro name
-    for(++lexForward; lexForward < src->length(); lexForward++) {
-        char ascii  = src->at(lexForward).toLatin1();
-        if(ascii == 0 || ascii == '\r' || ascii == '\n') {
-            return QString();
-        } else if(ascii == ' '){
-            // set  pointer for processing extra whitespace
-            lexBase = lexForward;
-            break;
-        } else {
-            macro.push_back(src->at(lexForward));
+    qsizetype pos = 0;
+    int defineIndex = 0;
+    auto appendDefines = [&](int count) {
+        // 宏定义按原有顺序插入，位置换算为拼接后输出中的位置
+        for(; defineIndex < count; defineIndex++) {
+            MacroDefine define = unit.defines.at(defineIndex);
+            appendRange(unit.text, pos, define.offset);
+            pos = define.offset;
+            if(sink != nullptr) {
+                storeSymbolToMap(define.symbol, define.target);
+                continue;
+            }
+            define.offset = dst.size();
+            defineList.append(define);
         }
+    };
+    for(const IncludeDirective & include : unit.includes) {
+        appendDefines(include.defineCount);
+        appendRange(unit.text, pos, include.offset);
+        pos = include.offset;
+        expandInclude(include.filename);
     }
-    return macro;
+    appendDefines(unit.defines.size());
+    appendRange(unit.text, pos, unit.text.size());
 }
 
-QString PreProcess::getFilePath()
+void PreProcess::appendRange(const QByteArray &text, qsizetype begin, qsizetype end)
 {
-    QString filename;
-    char ascii = src->at(lexForward).toLatin1();
-    if(ascii != '"') {
-       throw QString("文件路径错误");
+    if(begin < end && text.at(begin) == ' ' && (dst.isEmpty() || dst.at(dst.size() - 1) == ' ')) {
+        begin++;
+    }
+    if(begin >= end) { return; }
+    if(sink == nullptr) {
+        dst.append(text.constData() + begin, end - begin);
+    } else if(symbolMap.isEmpty()) {
+        emitRange(text.constData() + begin, end - begin);
     } else {
-        if(lexForward >= src->length() - 1) {throw QString("文件路径错误");}
-        lexForward++;
-        for(;  lexForward < src->length() ; lexForward++) {
-            ascii = (src->at(lexForward)).toLatin1();
-            if(ascii == '\t' | ascii == '\n' | ascii == '\r') { throw QString("文件路径错误"); }
-            if(ascii == '"') {break;}
-            filename.push_back(src->at(lexForward));
-        }
-        lexForward++;
+        QList<QByteArray> expanding;
+        substituteRange(text.constData(), begin, end, expanding);
     }
-    return filename;
 }
 
-bool PreProcess::openFile(QString &filename, QString & text)
+void PreProcess::emitRange(const char *data, qsizetype length)
 {
-    if(filename.isEmpty()) { return false; }
-    QDir dir(filename);
-     QFile file(dir.absolutePath());
-    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)) {return false;}
-    QTextStream stream(&file);
-    stream.setAutoDetectUnicode(true);
-    text = stream.readAll();
-    return true;
+    while(length > 0) {
+        qsizetype piece = qMin(length, SinkChunkLength);
+        dst.append(data, piece);
+        flushSink(false);
+        data += piece;
+        length -= piece;
+    }
 }
 
-void PreProcess::setIncludeFile()
+void PreProcess::flushSink(bool final)
 {
-    // open target file
-    QString filename = getFilePath();
-    QString fileText;
-    if(!openFile(filename, fileText)) { throw QString("无法包含该文件"); }
-    // include files recursivly
-    // TODO: exception may cause memory leak fix it
-    recursiveFileProcess(fileText);
-    // replace the macro with file text
-    replaceTargetStr(stateBase, lexForward, fileText);
+    if(!final && dst.size() < SinkChunkLength) { return; }
+    qsizetype count = final ? dst.size() : dst.size() - 1;
+    if(count > 0) { (*sink)(dst.constData(), count); }
+    dst.remove(0, count);
 }
 
-void PreProcess::getSymbolName(QString &str)
+void PreProcess::expandInclude(const QString &filename)
 {
-    char ascii;
-    for(; lexForward < src->length(); lexForward++) {
-        ascii = (src->at(lexForward)).toLatin1();
-        if(ascii == ' ' || ascii == '\t' | ascii == '\n' | ascii == '\r') {break;}
-        str.push_back(src->at(lexForward));
+    QFileInfo info;
+    QString path = resolveInclude(filename, info);
+    if(path.isEmpty()) { throw QString("无法包含该文件"); }
+    if(includeStack.contains(path)) {
+        QStringList chain = includeStack.mid(includeStack.indexOf(path));
+        chain.append(path);
+        throw QString("头文件循环包含: ") + chain.join(" -> ");
     }
-    lexBase = lexForward;
+    appendSpace();
+    // 同一文件在一个翻译单元中只展开一次
+    if(includedFiles.contains(path)) { return; }
+    includedFiles.insert(path);
+
+    QSharedPointer<const PreProcessUnit> unit = loadUnit(path, info);
+    includeStack.append(path);
+    assembleUnit(*unit);
+    includeStack.removeLast();
+    appendSpace();
 }
 
-void PreProcess::storeSymbolToMap(QString &symbol, QString &target)
+void PreProcess::redressSymbol()
 {
-    auto item = PreProcess::symbolMap.find(symbol);
-    if(item !=PreProcess::symbolMap.end()) {
-        PreProcess::symbolMap.insert(symbol, target);
-    } else {
-        PreProcess::symbolMap.remove(symbol);
-        PreProcess::symbolMap.insert(symbol, target);
+    dst.clear();
+    dst.reserve(srcLength);
+    QList<QByteArray> expanding;
+    qsizetype pos = 0;
+    // 宏定义自其所在位置起生效，按位置顺序穿插替换与登记
+    for(const MacroDefine & define : std::as_const(defineList)) {
+        substituteRange(src, pos, define.offset, expanding);
+        storeSymbolToMap(define.symbol, define.target);
+        pos = define.offset;
     }
+    substituteRange(src, pos, srcLength, expanding);
 }
 
-void PreProcess::replaceSymbolInFile(QString symbol, QString target)
+void PreProcess::substituteRange(const char *data, qsizetype begin, qsizetype end,
+                                 QList<QByteArray> & expanding)
 {
-    int index = src->indexOf(symbol);
-    int reScanPos = 0;
-    while(index != -1) {
-        // 防止截取到连续标识符中的Symbol
-        int begin = index - 1, end = index + symbol.length();
-        if((begin >= 0 && isIdChar(src->at(begin)) ||
-            (end < src->length() && isIdChar(src->at(end))))) {
-            reScanPos = index + 1;
-        } else {
-            src->replace(index, symbol.length(), target);
+    QByteArray key;
+    qsizetype pos = begin;
+    while(pos < end) {
+        if(sink != nullptr) { flushSink(false); }
+        qsizetype runBase = pos;
+        while(pos < end && !isIdChar(data[pos]) && data[pos] != '"') { pos++; }
+        if(pos > runBase) { dst.append(data + runBase, pos - runBase); }
+        if(pos >= end) { break; }
+
+        runBase = pos;
+        if(data[pos] == '"') {
+            // 字符串常量中的内容不做替换
+            const void *close = memchr(data + pos + 1, '"', size_t(end - pos - 1));
+            pos = close ? static_cast<const char *>(close) - data + 1 : end;
+            dst.append(data + runBase, pos - runBase);
+            continue;
+        }
+        pos = ByteScan::skipIdChars(data + pos, data + end) - data;
+        if(data[runBase] >= '0' && data[runBase] <= '9') {
+            // 数字开头的字符序列不是标识符
+            dst.append(data + runBase, pos - runBase);
+            continue;
         }
-        index = src->indexOf(symbol, reScanPos);
+        key.setRawData(data + runBase, pos - runBase);
+        auto mapIter = symbolMap.constFind(key);
+        if(mapIter == symbolMap.constEnd() || expanding.contains(mapIter.key())) {
+            dst.append(data + runBase, pos - runBase);
+            continue;
+        }
+        // 展开结果继续替换其中的其他宏，正在展开的宏不再展开以免无限递归
+        const QByteArray & target = mapIter.value();
+        expanding.append(mapIter.key());
+        substituteRange(target.constData(), 0, target.size(), expanding);
+        expanding.removeLast();
     }
 }
 
-void PreProcess::setDefineSymbol()
+void PreProcess::trimSrc()
+{
+    qsizetype spaceCnt = 0;
+    while(spaceCnt < dst.size() && dst.at(spaceCnt) == ' ') { spaceCnt++; }
+    dst.remove(0, spaceCnt);
+    spaceCnt = 0;
+    while(spaceCnt < dst.size() && dst.at(dst.size() - 1 - spaceCnt) == ' ') { spaceCnt++; }
+    dst.chop(spaceCnt);
+}
+
+QByteArray PreProcess::getMacroName()
+{
+    qsizetype base = ++lexForward;
+    for(; lexForward < srcLength; lexForward++) {
+        char ascii = src[lexForward];
+        if(ascii == 0 || ascii == '\r' || ascii == '\n') {
+            return QByteArray();
+        } else if(ascii == ' ' || ascii == '\t'){
+            break;
+        }
+    }
+    return QByteArray(src + base, lexForward - base);
+}
+
+QString PreProcess::getFilePath()
+{
+    if(lexForward >= srcLength || src[lexForward] != '"') {
+        throw QString("文件路径错误");
+    }
+    qsizetype base = ++lexForward;
+    for(; lexForward < srcLength; lexForward++) {
+        char ascii = src[lexForward];
+        if(ascii == '\t' || ascii == '\n' || ascii == '\r') { throw QString("文件路径错误"); }
+        if(ascii == '"') { break; }
+    }
+    if(lexForward >= srcLength) { throw QString("文件路径错误"); }
+    QString filename = QString::fromUtf8(src + base, int(lexForward - base));
+    lexForward++;
+    return filename;
+}
+
+void PreProcess::setIncludeFile()
+{
+    // 包含文件在拼接翻译单元时展开，此处只记录位置
+    IncludeDirective include;
+    include.filename = getFilePath();
+    include.offset = dst.size();
+    include.defineCount = defineList.size();
+    includeList.append(include);
+}
+
+void PreProcess::getSymbolName(QByteArray &str)
 {
-    QString symbol;
-    QString target;
-    getSymbolName(symbol);
-    whiteHandle(lexBase);
-    getSymbolName(target);
-    storeSymbolToMap(symbol, target);
-    replaceTargetStr(stateBase, lexForward, "");
+    qsizetype base = lexForward;
+    for(; lexForward < srcLength; lexForward++) {
+        if(isWhiteChar(src[lexForward])) {break;}
+    }
+    str = QByteArray(src + base, lexForward - base);
 }
 
-void PreProcess::replaceTargetStr(int & base, int end, QString replace)
+void PreProcess::storeSymbolToMap(const QByteArray &symbol, const QByteArray &target)
 {
-    src->replace(base, (end - base), replace);
-    lexBase = lexForward = base = base + replace.length();
+    symbolMap.insert(symbol, target);
+}
+
+void PreProcess::setDefineSymbol()
+{
+    MacroDefine define;
+    getSymbolName(define.symbol);
+    skipWhite();
+    getSymbolName(define.target);
+    define.offset = dst.size();
+    defineList.append(define);
 }
 
 void PreProcess::macroHandle()
 {
-    lexBase = stateBase;
-    QString macro = getMacroName();
-    whiteHandle(lexBase);
-    if(macro == QString("include")) {
+    lexForward = stateBase;
+    QByteArray macro = getMacroName();
+    skipWhite();
+    if(macro == "include") {
         setIncludeFile();
-    } else if (macro == QString("define")) {
+    } else if (macro == "define") {
         setDefineSymbol();
     } else {
         throw QString("无法识别的预处理指令");
     }
+    stateBase = lexForward;
 }
 
 void PreProcess::notationHandle()
 {
-    lexForward= lexBase = stateBase;
-    if(src->at(lexForward + 1) == '/') {
-        while(true) {
-            lexForward++;
-            if(lexForward >= src->length()) {break ;}
-            if(src->at(lexForward) == '\n') { lexForward++; break; }
-        }
-        replaceTargetStr(stateBase, lexForward, "");
-    } else if(src->at(lexForward + 1) == '*') {
-        bool flag = false;
-        lexForward++;
-        while(true) {
-            lexForward++;
-            if(lexForward >= src->length()) {break ;}
-            if(src->at(lexForward) == '*') { flag = true; }
-            else if (src->at(lexForward) == '/' && flag) { lexForward++; break; }
-            else {
-                flag = false;
-            }
-        }
-        replaceTargetStr(stateBase, lexForward, "");
+    lexForward = stateBase + 1;
+    if(lexForward < srcLength && src[lexForward] == '/') {
+        const void *end = memchr(src + lexForward, '\n', size_t(srcLength - lexForward));
+        lexForward = end ? static_cast<const char *>(end) - src + 1 : srcLength;
+    } else if(lexForward < srcLength && src[lexForward] == '*') {
+        const char *close = ByteScan::findCommentEnd(src + lexForward + 1, src + srcLength);
+        lexForward = close < src + srcLength ? close - src + 2 : srcLength;
+    } else {
+        // 单独的 '/' 为除法运算符，原样保留
+        dst.push_back(src[stateBase]);
+        stateBase++;
+        return;
     }
+    // 注释与空白一样起分隔作用
+    appendSpace();
+    stateBase = lexForward;
 }
 
-void PreProcess::whiteHandle(int & startPos)
+void PreProcess::whiteHandle()
 {
-    // note that lexBase and lexForward will jump over whitespace automatically
-    QChar curChar;
-    lexForward = startPos;
-    bool beforeSpaceFlag = false;
+    stateBase = ByteScan::skipWhite(src + stateBase, src + srcLength) - src;
+    appendSpace();
+}
 
-    if(lexForward - 1 >= 0 && src->at(lexForward-1) == ' ') {
-        beforeSpaceFlag = true;
-    }
-    while(true) {
-        lexForward++;
-        if(lexForward >= src->length()) {break ;}
-        curChar = src->at(lexForward);
-        if( !(curChar == ' ' || curChar == '\t' || curChar == '\n' || curChar == '\r')) {
-            break;
-        }
-    }
-    if(beforeSpaceFlag) {
-        stateBase--;
-        lexBase--;
+void PreProcess::skipWhite()
+{
+    lexForward = ByteScan::skipWhite(src + lexForward, src + srcLength) - src;
+}
+
+void PreProcess::appendSpace()
+{
+    if(!dst.isEmpty() && dst.at(dst.size() - 1) != ' ') {
+        dst.push_back(' ');
     }
-    replaceTargetStr(startPos, lexForward, " ");
 }
 
 void PreProcess::scanJump()
 {
-    lexForward = lexBase = stateBase;
-    QChar curChar;
-    while(true) {
-        lexForward++;
-        curChar = src->at(lexForward);
-        if(curChar == '"') {
-            lexForward++;
-            break;
-        }
-    }
-    stateBase = lexBase = lexForward;
+    const void *end = memchr(src + stateBase + 1, '"', size_t(srcLength - stateBase - 1));
+    if(end == nullptr) { throw QString("字符串缺少结束引号"); }
+    qsizetype close = static_cast<const char *>(end) - src + 1;
+    dst.append(src + stateBase, close - stateBase);
+    stateBase = close;
 }
 
-void PreProcess::scanBackspace()
+bool PreProcess::isWhiteChar(char character)
 {
-    if(stateBase >=0) {
-        stateBase--;
-    } else {
-        stateBase = -1;
-    }
+    return character == ' ' || character == '\t' || character == '\n' || character == '\r';
 }
 
-bool PreProcess::isIdChar(QChar character)
+bool PreProcess::isIdChar(char character)
 {
-    char ascii = character.toLatin1();
-    if((ascii > 'a' && ascii < 'z') || (ascii > 'A' && ascii < 'Z') || (ascii > '0' && ascii < '9')) {
+    if((character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z')
+            || (character >= '0' && character <= '9') || character == '_') {
         return true;
     }
     return false;
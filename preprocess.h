@@ -2,66 +2,250 @@
 #define PREPROCESS_H
 
 #include <exception>
+#include <functional>
 
+#include <QByteArray>
 #include <QDir>
-#include <QMap>
+#include <QFileInfo>
+#include <QHash>
+#include <QList>
+#include <QSet>
 #include <QString>
-#include <QTextStream>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+#include "includecache.h"
+#include "sourcefile.h"
 
 /**
  * @brief 预处理类
  * @details 该类将输入的代码字符串进行包含、宏定义以及空白符删减处理
  *  主要实现的功能有
- *  1. #include "相对路径"  该指令将指定的代码文件递归进行文本复制与展开
- *  2. #define SYMBOL target  该指令将指定的标识符替换为目标文本
+ *  1. #include "相对路径"  该指令将指定的代码文件递归进行文本复制与展开，
+ *     同一文件在一个翻译单元中只展开一次，循环包含时报错，
+ *     互不依赖的包含文件在线程池中并行读取与识别
+ *  2. #define SYMBOL target  该指令将指定的标识符替换为目标文本，宏定义只在所在翻译单元中有效
  *  3. 该类将注释、连续空格、换行等文本内容进行删除
+ *  该类不含静态可变状态，不同实例可以在不同线程中同时使用
  */
 class PreProcess
 {
 public:
+        /**
+         * @brief OutputSink 分块接收预处理结果的回调，参数为数据起始指针与字节数
+         */
+        using OutputSink = std::function<void(const char *, qsizetype)>;
+        /**
+         * @brief ProgressHandler 进度回调，参数为已处理的字节数与总字节数，返回 false 时取消处理
+         */
+        using ProgressHandler = std::function<bool(qsizetype, qsizetype)>;
+
         PreProcess();
 
         /**
          * @brief start 开始预处理
-         * @param src 设置数据源
+         * @param src 设置数据源，处理成功后替换为预处理结果
          * @return  预处理是否成功
          */
-        bool start(QString & src);
+        bool start(QByteArray & src);
+        /**
+         * @brief start 直接对映射的源码文件进行预处理
+         * @param file 源码文件
+         * @param result 带出预处理结果
+         * @return 预处理是否成功
+         */
+        bool start(const SourceFile & file, QByteArray & result);
+        /**
+         * @brief start 预处理源码文件并将结果分块交给 sink，不生成完整的预处理结果
+         * @details 包含展开与宏替换在拼接时同步完成，输出缓冲区不超过 SinkChunkLength 的两倍，
+         *  送出的内容与其他接口的预处理结果相比只可能在空白上有差别，
+         *  sink 中抛出的 QString 异常同样作为预处理错误报告
+         * @param file 源码文件
+         * @param sink 预处理结果接收者
+         * @return 预处理是否成功
+         */
+        bool start(const SourceFile & file, const OutputSink & sink);
+        /**
+         * @brief start 预处理内存中的源码并将结果分块交给 sink
+         * @param src 数据源
+         * @param sink 预处理结果接收者
+         * @return 预处理是否成功
+         */
+        bool start(const QByteArray & src, const OutputSink & sink);
 
         const QString &getErrMsg() const;
 
+        /**
+         * @brief setIncludeDir 设置相对路径包含文件的查找目录
+         * @param dir 查找目录，为空时使用当前工作目录
+         */
+        void setIncludeDir(const QString &dir);
+
+        /**
+         * @brief clearIncludeCache 清空包含文件缓存
+         */
+        void clearIncludeCache();
+        /**
+         * @brief setIncludeCache 与其他预处理器共用包含文件缓存
+         * @details 缓存本身可以被多个线程同时访问，批处理时各线程共用一份缓存，
+         *  同一头文件在整批处理中只识别一次
+         * @param cache 包含文件缓存
+         */
+        void setIncludeCache(const QSharedPointer<IncludeCache> & cache);
+
+        /**
+         * @brief setProgressHandler 设置进度回调
+         * @details 识别主源码时每处理 ProgressStep 字节调用一次，回调在执行预处理的线程中调用，
+         *  返回 false 时预处理以“处理已取消”失败；包含文件与宏替换不单独报告进度
+         * @param handler 进度回调，为空时不报告
+         */
+        void setProgressHandler(const ProgressHandler & handler);
+
 private:
-        QString* src;   // 待处理数据源
+        const char* src = nullptr;  // 待处理数据源(UTF-8 字节)
+        qsizetype srcLength = 0;    // 数据源字节数
+        QByteArray dst;     // 预处理输出缓冲区
         QString errMsg; // 错误信息
-        static QMap<QString, QString> symbolMap; // 宏定义表
+        QString includeDir; // 包含文件查找目录
+        QHash<QByteArray, QByteArray> symbolMap;    // 当前翻译单元的宏定义表
+        QVector<MacroDefine> defineList;    // 按出现顺序记录的宏定义
+        QVector<IncludeDirective> includeList;  // 按出现顺序记录的包含指令
+        QSharedPointer<IncludeCache> includeCache;  // 包含文件识别结果缓存，在多次预处理之间保留
+        QSet<QString> includedFiles;    // 当前翻译单元已展开的文件
+        QStringList includeStack;   // 正在展开的包含链
+        const OutputSink * sink = nullptr;  // 分块输出时的结果接收者
+        ProgressHandler progressHandler;    // 进度回调，包含文件由其他实例识别，不会调用
 
-        int stateBase = 0;  // 预处理指定起始指针
-        int lexBase = 0;    //  语法项开始指针
-        int lexForward = 0; // 前向扫描指针
+        const qsizetype SinkChunkLength = 16 * 1024;   // 分块输出时每块的字节数
+        const qsizetype ProgressStep = 256 * 1024;     // 相邻两次报告进度之间处理的字节数
+
+        qsizetype stateBase = 0;  // 预处理指定起始指针
+        qsizetype lexForward = 0; // 前向扫描指针
+
+        /**
+         * @brief process 对给定数据执行完整预处理
+         * @param data 数据源起始指针
+         * @param length 数据源字节数
+         * @param filename 数据源文件路径名，不来自文件时为空
+         * @param result 带出预处理结果
+         * @return 预处理是否成功
+         */
+        bool process(const char *data, qsizetype length, const QString & filename,
+                     QByteArray & result);
+        /**
+         * @brief streamProcess 对给定数据执行预处理，结果分块交给 sink
+         * @param data 数据源起始指针
+         * @param length 数据源字节数
+         * @param filename 数据源文件路径名，不来自文件时为空
+         * @param output 预处理结果接收者
+         * @return 预处理是否成功
+         */
+        bool streamProcess(const char *data, qsizetype length, const QString & filename,
+                           const OutputSink & output);
+        /**
+         * @brief initUnitState 开始新的翻译单元，重置包含状态与宏定义表
+         * @param filename 主文件路径名，不来自文件时为空
+         */
+        void initUnitState(const QString & filename);
 
         /**
          * @brief mainRecognize 主分析函数
+         * @details 自前向后单遍扫描数据源，处理结果追加到输出缓冲区，不修改数据源，
+         *  不需要处理的字节段由 ByteScan::findSpecial 按向量批量跳过
          */
         void mainRecognize();
 
         /**
-         * @brief recursiveFileProcess 递归解析包含文件
-         * @param fileText 带出递归处理得到的子文件内容
+         * @brief recognizeUnit 识别单个文件，不展开其中的包含指令
+         * @param data 数据源起始指针
+         * @param length 数据源字节数
+         * @param unit 带出识别结果
          */
-        void recursiveFileProcess(QString & fileText);
+        void recognizeUnit(const char *data, qsizetype length, PreProcessUnit & unit);
 
         /**
-         * @brief recursiveFileRecognize 递归包含文件识别
-         * @param src 数据源
+         * @brief PreProcess 构造识别包含文件的预处理器，与上层预处理器共用包含文件缓存，不再另行分配
+         * @param cache 上层预处理器的包含文件缓存
          */
-        void recursiveFileRecognize(QString &src);
+        explicit PreProcess(const QSharedPointer<IncludeCache> & cache);
+
+        /**
+         * @brief recursiveFileProcess 识别包含文件
+         * @param file 包含的源码文件
+         * @param unit 带出识别结果
+         */
+        void recursiveFileProcess(const SourceFile & file, PreProcessUnit & unit) const;
+
+        /**
+         * @brief loadUnit 获取包含文件的识别结果，优先使用缓存
+         * @param path 规范化文件路径
+         * @param info 文件信息
+         * @return 识别结果
+         */
+        QSharedPointer<const PreProcessUnit> loadUnit(const QString & path, const QFileInfo & info);
+
+        /**
+         * @brief resolveInclude 解析包含指令中的文件路径
+         * @param filename 指令中的文件路径名
+         * @param info 带出文件信息
+         * @return 规范化文件路径，文件不存在时为空
+         */
+        QString resolveInclude(const QString & filename, QFileInfo & info) const;
+        /**
+         * @brief prefetchUnits 并行加载包含树中尚未缓存的文件
+         * @details 按层遍历包含树，同一层的文件在线程池中同时读取与识别并存入缓存，
+         *  加载失败的文件留待顺序拼接时再次加载并报告错误
+         * @param unit 翻译单元主文件的识别结果
+         */
+        void prefetchUnits(const PreProcessUnit & unit);
+
+        /**
+         * @brief assembleUnit 将识别结果追加到输出并展开其中的包含指令
+         * @param unit 识别结果
+         */
+        void assembleUnit(const PreProcessUnit & unit);
+        /**
+         * @brief appendRange 追加识别结果中的一段文本，合并衔接处的重复空格
+         * @param text 识别结果文本
+         * @param begin 区间开始位置
+         * @param end 区间结束位置
+         */
+        void appendRange(const QByteArray & text, qsizetype begin, qsizetype end);
+        /**
+         * @brief emitRange 分块输出时追加一段已替换的文本，每攒够一块交给 sink
+         * @param data 文本起始指针
+         * @param length 文本字节数
+         */
+        void emitRange(const char *data, qsizetype length);
+        /**
+         * @brief flushSink 将输出缓冲区中的数据交给 sink
+         * @details 未结束时保留最后一个字节，使后续拼接仍能判断是否需要合并空格
+         * @param final 是否为最后一次输出
+         */
+        void flushSink(bool final);
+        /**
+         * @brief expandInclude 展开一条包含指令
+         * @param filename 指令中的文件路径名
+         */
+        void expandInclude(const QString & filename);
 
         /**
          * @brief redressSymbol 替换所有宏定义数据
+         * @details 单遍扫描标识符并在宏定义表中查找，命中时直接输出展开结果
          */
         void redressSymbol();
         /**
-         * @brief trimSrc 删除源码前后空格
+         * @brief substituteRange 替换指定区间内的宏标识符并追加到输出
+         * @param data 数据起始指针
+         * @param begin 区间开始位置
+         * @param end 区间结束位置
+         * @param expanding 正在展开的宏标识符
+         */
+        void substituteRange(const char *data, qsizetype begin, qsizetype end,
+                             QList<QByteArray> & expanding);
+        /**
+         * @brief trimSrc 删除预处理结果前后空格
          */
         void trimSrc();
 
@@ -75,15 +259,23 @@ private:
         void notationHandle();
         /**
          * @brief whiteHandle 编辑字符处理函数
-         * @param startPos 开始位置
+         * @details 连续的空白字符在输出中合并为一个空格，较长的空白段按向量批量跳过
          */
-        void whiteHandle(int & startPos);
+        void whiteHandle();
+        /**
+         * @brief skipWhite 指令解析时跳过空白字符
+         */
+        void skipWhite();
+        /**
+         * @brief appendSpace 向输出追加分隔空格，已有空格时不重复追加
+         */
+        void appendSpace();
 
         /**
          * @brief getMacroName 获取宏指令类型
          * @return 宏指令类型名称
          */
-        QString getMacroName();
+        QByteArray getMacroName();
 
         /**
          * @brief getFilePath 获取当前文件路径
@@ -91,14 +283,7 @@ private:
          */
         QString getFilePath();
         /**
-         * @brief openFile 打开文件
-         * @param filename 文件路径名
-         * @param text 带出的文件内容
-         * @return 是否成功打开文件
-         */
-        bool openFile(QString & filename, QString & text);
-        /**
-         * @brief setIncludeFile 设置包含的文件内容
+         * @brief setIncludeFile 记录包含指令
          */
         void setIncludeFile();
 
@@ -106,46 +291,34 @@ private:
          * @brief getSymbolName 获取宏定义标识符
          * @param str 标识符
          */
-        void getSymbolName(QString & str);
+        void getSymbolName(QByteArray & str);
         /**
          * @brief storeSymbolToMap 将宏标识符存入表中
          * @param symbol 宏定义标识符
          * @param target 替换内容
          */
-        void storeSymbolToMap(QString & symbol, QString & target);
-        /**
-         * @brief replaceSymbolInFile 替换文件中的宏定义标识符
-         * @param symbol 宏定义标识符
-         * @param target 替换内容
-         */
-        void replaceSymbolInFile(QString symbol, QString target);
+        void storeSymbolToMap(const QByteArray & symbol, const QByteArray & target);
         /**
          * @brief setDefineSymbol 设置宏定义标识符
          */
         void setDefineSymbol();
 
         /**
-         * @brief replaceTargetStr 替换目标串中的特定字符
-         * @param base 起始位置
-         * @param end 结束位置
-         * @param replace 带替换字串
-         */
-        void replaceTargetStr(int & base, int end, QString replace);
-
-        /**
-         * @brief scanJump 跳过扫描字符串注释等特定内容
+         * @brief scanJump 原样复制字符串常量
          */
         void scanJump();
-        /**
-         * @brief scanBackspace 扫描回退一字符
-         */
-        void scanBackspace();
         /**
          * @brief isIdChar 是否为构成标识符的字符
          * @param character 给定字符
          * @return 是否为构成标识符的字符
          */
-        bool isIdChar(QChar character);
+        static bool isIdChar(char character);
+        /**
+         * @brief isWhiteChar 是否为空白字符
+         * @param character 给定字符
+         * @return 是否为空白字符
+         */
+        static bool isWhiteChar(char character);
 };
 
 #endif // PREPROCESS_H
@@ -0,0 +1,150 @@
+#include "sourcefile.h"
+
+#include <cstring>
+
+#include <QTextStream>
+
+SourceFile::SourceFile() {}
+
+SourceFile::~SourceFile()
+{
+    close();
+}
+
+bool SourceFile::open(const QString &filename)
+{
+    close();
+    file.setFileName(filename);
+    if(!file.open(QIODevice::ReadOnly)) { return false; }
+
+    qint64 fileSize = file.size();
+    if(fileSize > 0) {
+        mapped = file.map(0, fileSize);
+    }
+    if(mapped != nullptr) {
+        begin = reinterpret_cast<const char *>(mapped);
+        length = fileSize;
+    } else {
+        // 管道等无法映射的设备退回到整体读取
+        buffer = file.readAll();
+        begin = buffer.constData();
+        length = buffer.size();
+    }
+
+    const uchar *head = reinterpret_cast<const uchar *>(begin);
+    if(length >= 3 && head[0] == 0xEF && head[1] == 0xBB && head[2] == 0xBF) {
+        begin += 3;
+        length -= 3;
+    } else if(length >= 2 && ((head[0] == 0xFF && head[1] == 0xFE) ||
+                              (head[0] == 0xFE && head[1] == 0xFF))) {
+        decodeUtf16();
+    }
+    return true;
+}
+
+void SourceFile::close()
+{
+    if(mapped != nullptr) {
+        file.unmap(mapped);
+        mapped = nullptr;
+    }
+    if(file.isOpen()) { file.close(); }
+    buffer.clear();
+    begin = nullptr;
+    length = 0;
+}
+
+const char *SourceFile::data() const
+{
+    return begin;
+}
+
+qint64 SourceFile::size() const
+{
+    return length;
+}
+
+QString SourceFile::fileName() const
+{
+    return file.fileName();
+}
+
+bool SourceFile::isMapped() const
+{
+    return mapped != nullptr;
+}
+
+SourceFile::Encoding SourceFile::encoding() const
+{
+    return isUtf8(begin, length) ? Utf8 : Latin1;
+}
+
+QString SourceFile::text() const
+{
+    QString text = encoding() == Utf8 ? QString::fromUtf8(begin, int(length))
+                                      : QString::fromLatin1(begin, int(length));
+    text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+    return text;
+}
+
+bool SourceFile::isUtf8(const char *data, qint64 size)
+{
+    const uchar *text = reinterpret_cast<const uchar *>(data);
+    qint64 pos = 0;
+    while(pos < size) {
+        // 成段的 ASCII 字节每次检查 8 个
+        quint64 word = 0;
+        if(size - pos >= 8) {
+            memcpy(&word, text + pos, 8);
+            if((word & Q_UINT64_C(0x8080808080808080)) == 0) {
+                pos += 8;
+                continue;
+            }
+        }
+        uchar lead = text[pos];
+        if(lead < 0x80) {
+            pos++;
+            continue;
+        }
+        int follow = 0;
+        quint32 code = 0;
+        if(lead >= 0xC2 && lead <= 0xDF) {
+            follow = 1;
+            code = lead & 0x1F;
+        } else if(lead >= 0xE0 && lead <= 0xEF) {
+            follow = 2;
+            code = lead & 0x0F;
+        } else if(lead >= 0xF0 && lead <= 0xF4) {
+            follow = 3;
+            code = lead & 0x07;
+        } else {
+            return false;
+        }
+        if(size - pos <= follow) { return false; }
+        for(int i = 1; i <= follow; i++) {
+            if((text[pos + i] & 0xC0) != 0x80) { return false; }
+            code = (code << 6) | (text[pos + i] & 0x3F);
+        }
+        // 拒绝过长编码、代理区与超出 Unicode 范围的码点
+        if((follow == 2 && (code < 0x800 || (code >= 0xD800 && code <= 0xDFFF)))
+                || (follow == 3 && (code < 0x10000 || code > 0x10FFFF))) {
+            return false;
+        }
+        pos += follow + 1;
+    }
+    return true;
+}
+
+void SourceFile::decodeUtf16()
+{
+    const QByteArray raw(begin, int(length));
+    QTextStream stream(raw);
+    stream.setAutoDetectUnicode(true);
+    buffer = stream.readAll().toUtf8();
+    if(mapped != nullptr) {
+        file.unmap(mapped);
+        mapped = nullptr;
+    }
+    begin = buffer.constData();
+    length = buffer.size();
+}
@@ -0,0 +1,103 @@
+#ifndef SOURCEFILE_H
+#define SOURCEFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+/**
+ * @brief 源码文件输入类
+ * @details 通过 QFile::map 将源码文件映射到内存，预处理与词法分析直接读取映射的字节，
+ *  不再经过 QTextStream 解码为 UTF-16 字符串
+ *  1. 无 BOM 或带 UTF-8 BOM 的文件按字节直接使用，不产生拷贝，内容可以是 UTF-8 或 Latin-1，
+ *     两者的 ASCII 部分相同，非 ASCII 字节只出现在注释与字符串中，分析时无需区分
+ *  2. 带 UTF-16 BOM 的文件解码后转存为 UTF-8
+ *  3. 无法映射的文件(如管道、空文件)整体读入内存
+ */
+class SourceFile
+{
+public:
+    /**
+     * @brief 文件内容的字节编码
+     */
+    enum Encoding {
+        Utf8,       // UTF-8，纯 ASCII 文件也属于此类
+        Latin1      // 含有不构成合法 UTF-8 序列的字节时按 Latin-1 处理
+    };
+
+    SourceFile();
+    ~SourceFile();
+
+    /**
+     * @brief open 打开并映射源码文件
+     * @param filename 文件路径名
+     * @return 是否成功打开
+     */
+    bool open(const QString & filename);
+
+    /**
+     * @brief close 解除映射并关闭文件
+     */
+    void close();
+
+    /**
+     * @brief data 获取文件内容起始指针
+     * @return UTF-8 字节序列，不保证以 '\0' 结尾
+     */
+    const char *data() const;
+
+    /**
+     * @brief size 获取文件内容字节数
+     * @return 字节数
+     */
+    qint64 size() const;
+
+    /**
+     * @brief fileName 获取打开的文件路径名
+     * @return 文件路径名
+     */
+    QString fileName() const;
+
+    /**
+     * @brief isMapped 文件内容是否直接来自内存映射
+     * @return 是否为内存映射
+     */
+    bool isMapped() const;
+
+    /**
+     * @brief encoding 检测文件内容的编码
+     * @details 需要扫描全部内容，只在转换为 UTF-16 字符串时使用，分析本身不依赖编码
+     * @return 内容为合法 UTF-8 时返回 Utf8，否则返回 Latin1
+     */
+    Encoding encoding() const;
+
+    /**
+     * @brief text 将文件内容解码为字符串，仅供界面显示使用
+     * @return 按检测出的编码解码后的字符串，换行统一为 '\n'
+     */
+    QString text() const;
+
+    /**
+     * @brief isUtf8 给定字节序列是否为合法的 UTF-8
+     * @param data 字节序列起始指针
+     * @param size 字节数
+     * @return 是否合法
+     */
+    static bool isUtf8(const char *data, qint64 size);
+
+private:
+    Q_DISABLE_COPY(SourceFile)
+
+    QFile file;                     // 源码文件
+    uchar *mapped = nullptr;        // 内存映射起始地址
+    const char *begin = nullptr;    // 文件内容起始指针(已跳过 BOM)
+    qint64 length = 0;              // 文件内容字节数
+    QByteArray buffer;              // 转码或无法映射时的文件内容
+
+    /**
+     * @brief decodeUtf16 将带 UTF-16 BOM 的文件转存为 UTF-8
+     */
+    void decodeUtf16();
+};
+
+#endif // SOURCEFILE_H
@@ -0,0 +1,113 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <utility>
+
+#include <QThread>
+#include <QVector>
+
+/**
+ * @brief 单生产者单消费者环形队列
+ * @details 生产者只修改 tail，消费者只修改 head，两者通过 acquire/release 原子操作同步，
+ *  数据通路上不使用锁；队列满或空时先自旋，再让出时间片，最后短暂休眠等待
+ *  生产者调用 close 表示数据结束，任意一方调用 abort 使双方的等待立即返回
+ */
+template<typename T>
+class SpscRing
+{
+public:
+    /**
+     * @brief SpscRing 构造队列
+     * @param capacity 容量，向上取整为 2 的幂
+     */
+    explicit SpscRing(int capacity)
+    {
+        int size = 2;
+        while(size < capacity) { size *= 2; }
+        slots.resize(size);
+        mask = quint32(size - 1);
+    }
+
+    /**
+     * @brief push 生产者放入一项，队列满时等待
+     * @param item 放入的数据，成功时被移走
+     * @return 是否放入，队列已中止时返回 false
+     */
+    bool push(T && item)
+    {
+        quint32 pos = tail.load(std::memory_order_relaxed);
+        int spins = 0;
+        while(pos - head.load(std::memory_order_acquire) > mask) {
+            if(aborted.load(std::memory_order_acquire)) { return false; }
+            backoff(spins);
+        }
+        slots[int(pos & mask)] = std::move(item);
+        tail.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief pop 消费者取出一项，队列空时等待
+     * @param item 带出取出的数据
+     * @return 是否取出，队列已关闭且取空或已中止时返回 false
+     */
+    bool pop(T & item)
+    {
+        quint32 pos = head.load(std::memory_order_relaxed);
+        int spins = 0;
+        while(pos == tail.load(std::memory_order_acquire)) {
+            if(aborted.load(std::memory_order_acquire)) { return false; }
+            // 先读 closed 再确认一次 tail，避免漏掉关闭前最后放入的数据
+            if(closed.load(std::memory_order_acquire)) {
+                if(pos == tail.load(std::memory_order_acquire)) { return false; }
+                break;
+            }
+            backoff(spins);
+        }
+        item = std::move(slots[int(pos & mask)]);
+        head.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief close 生产者声明不再放入数据
+     */
+    void close()
+    {
+        closed.store(true, std::memory_order_release);
+    }
+
+    /**
+     * @brief abort 中止队列，等待中的 push 与 pop 立即返回 false
+     */
+    void abort()
+    {
+        aborted.store(true, std::memory_order_release);
+    }
+
+private:
+    QVector<T> slots;           // 环形存储区
+    quint32 mask = 0;           // 容量减一
+    alignas(64) std::atomic<quint32> head{0};   // 下一个取出位置，只由消费者修改
+    alignas(64) std::atomic<quint32> tail{0};   // 下一个放入位置，只由生产者修改
+    alignas(64) std::atomic<bool> closed{false};    // 生产者已结束
+    std::atomic<bool> aborted{false};   // 任意一方已中止
+
+    /**
+     * @brief backoff 等待对方线程，等待越久让出越多
+     * @param spins 已等待的次数
+     */
+    static void backoff(int & spins)
+    {
+        spins++;
+        if(spins < 64) { return; }
+        if(spins < 256) {
+            QThread::yieldCurrentThread();
+        } else {
+            QThread::usleep(50);
+        }
+    }
+};
+
+#endif // SPSCRING_H
@@ -0,0 +1,95 @@
+#include "symboltable.h"
+
+#include <cstring>
+
+SymbolTable::SymbolTable() {}
+
+void SymbolTable::clear()
+{
+    arena.truncate(0);
+    offsets.clear();
+    lengths.clear();
+    hashes.clear();
+    slots.clear();
+    mask = 0;
+}
+
+int SymbolTable::intern(const char *text, int length)
+{
+    // 装载因子超过 1/2 时扩容，保证探测序列较短
+    if((offsets.size() + 1) * 2 > slots.size()) { grow(); }
+    quint32 hash = hashBytes(text, length);
+    quint32 slot = findSlot(text, length, hash);
+    if(slots.at(int(slot)) >= 0) { return slots.at(int(slot)); }
+
+    int id = offsets.size();
+    offsets.append(quint32(arena.size()));
+    lengths.append(quint32(length));
+    hashes.append(hash);
+    arena.append(text, length);
+    slots[int(slot)] = id;
+    return id;
+}
+
+int SymbolTable::find(const char *text, int length) const
+{
+    if(slots.isEmpty()) { return -1; }
+    return slots.at(int(findSlot(text, length, hashBytes(text, length))));
+}
+
+int SymbolTable::size() const
+{
+    return offsets.size();
+}
+
+const char *SymbolTable::data(int id) const
+{
+    return arena.constData() + offsets.at(id);
+}
+
+int SymbolTable::length(int id) const
+{
+    return int(lengths.at(id));
+}
+
+QString SymbolTable::text(int id) const
+{
+    return QString::fromUtf8(data(id), length(id));
+}
+
+quint32 SymbolTable::hashBytes(const char *text, int length)
+{
+    quint32 hash = 2166136261u;
+    for(int i = 0; i < length; i++) {
+        hash ^= uchar(text[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+quint32 SymbolTable::findSlot(const char *text, int length, quint32 hash) const
+{
+    const char *base = arena.constData();
+    quint32 slot = hash & mask;
+    while(true) {
+        qint32 id = slots.at(int(slot));
+        if(id < 0) { return slot; }
+        if(hashes.at(id) == hash && lengths.at(id) == quint32(length)
+                && memcmp(base + offsets.at(id), text, size_t(length)) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+void SymbolTable::grow()
+{
+    int capacity = slots.isEmpty() ? 64 : slots.size() * 2;
+    slots.fill(-1, capacity);
+    mask = quint32(capacity - 1);
+    for(int id = 0; id < offsets.size(); id++) {
+        quint32 slot = hashes.at(id) & mask;
+        while(slots.at(int(slot)) >= 0) { slot = (slot + 1) & mask; }
+        slots[int(slot)] = id;
+    }
+}
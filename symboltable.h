@@ -0,0 +1,74 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief 标识符符号表
+ * @details 同一拼写的标识符只登记一次，并始终得到相同的编号
+ *  标识符字节连续存放在一块缓冲区中，查找使用开放定址(线性探测)哈希表，
+ *  编号按首次出现的顺序分配，缓冲区扩容不影响已分配的编号
+ */
+class SymbolTable
+{
+public:
+    SymbolTable();
+
+    void clear();
+
+    /**
+     * @brief intern 登记标识符
+     * @param text 标识符起始指针
+     * @param length 标识符字节数
+     * @return 标识符编号，已登记过的标识符返回原编号
+     */
+    int intern(const char *text, int length);
+    /**
+     * @brief find 查找标识符
+     * @param text 标识符起始指针
+     * @param length 标识符字节数
+     * @return 标识符编号，未登记时返回-1
+     */
+    int find(const char *text, int length) const;
+
+    int size() const;
+    /**
+     * @brief data 获取标识符字节，指针在下一次登记前有效
+     * @param id 标识符编号
+     * @return 标识符起始指针，不以 '\0' 结尾
+     */
+    const char *data(int id) const;
+    int length(int id) const;
+    /**
+     * @brief text 获取标识符文本
+     * @param id 标识符编号
+     * @return 标识符文本
+     */
+    QString text(int id) const;
+
+private:
+    QByteArray arena;           // 所有标识符的字节
+    QVector<quint32> offsets;   // 各标识符在缓冲区中的位置
+    QVector<quint32> lengths;   // 各标识符字节数
+    QVector<quint32> hashes;    // 各标识符哈希值，扩容时无需重新计算
+    QVector<qint32> slots;      // 哈希表槽位，存放标识符编号，-1 为空
+    quint32 mask = 0;           // 槽位数减一，槽位数为 2 的幂
+
+    /**
+     * @brief hashBytes 计算 FNV-1a 哈希值
+     */
+    static quint32 hashBytes(const char *text, int length);
+    /**
+     * @brief findSlot 查找标识符所在或应插入的槽位
+     * @return 槽位序号
+     */
+    quint32 findSlot(const char *text, int length, quint32 hash) const;
+    /**
+     * @brief grow 槽位数翻倍并重新放置所有标识符
+     */
+    void grow();
+};
+
+#endif // SYMBOLTABLE_H
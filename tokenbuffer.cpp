@@ -0,0 +1,188 @@
+#include "tokenbuffer.h"
+
+#include <algorithm>
+
+#include "lextable.h"
+
+namespace {
+
+/**
+ * @brief replaceRange 以 values 替换 column 中的 [first, first + count)
+ */
+template <typename T>
+void replaceRange(QVector<T> & column, int first, int count, const QVector<T> & values)
+{
+    int common = qMin(count, int(values.size()));
+    if(count > common) {
+        column.remove(first + common, count - common);
+    } else if(values.size() > common) {
+        column.insert(first + common, int(values.size()) - common, T());
+    }
+    std::copy(values.cbegin(), values.cend(), column.begin() + first);
+}
+
+} // namespace
+
+TokenBuffer::TokenBuffer() {}
+
+void TokenBuffer::clear()
+{
+    kinds.clear();
+    offsets.clear();
+    lengths.clear();
+    indexes.clear();
+}
+
+void TokenBuffer::reserve(int count)
+{
+    kinds.reserve(count);
+    offsets.reserve(count);
+    lengths.reserve(count);
+    indexes.reserve(count);
+}
+
+void TokenBuffer::truncate(int count)
+{
+    kinds.resize(count);
+    offsets.resize(count);
+    lengths.resize(count);
+    indexes.resize(count);
+}
+
+void TokenBuffer::append(Kind kind, qsizetype offset, qsizetype length, int index)
+{
+    Q_ASSERT(offset >= 0 && length >= 0 && offset + length <= MaxSourceSize);
+    kinds.append(quint8(kind));
+    offsets.append(quint32(offset));
+    lengths.append(quint32(length));
+    indexes.append(qint32(index));
+}
+
+void TokenBuffer::append(const TokenBuffer &other)
+{
+    kinds.append(other.kinds);
+    offsets.append(other.offsets);
+    lengths.append(other.lengths);
+    indexes.append(other.indexes);
+}
+
+void TokenBuffer::append(const TokenBuffer &other, int first, int count)
+{
+    kinds.append(other.kinds.mid(first, count));
+    offsets.append(other.offsets.mid(first, count));
+    lengths.append(other.lengths.mid(first, count));
+    indexes.append(other.indexes.mid(first, count));
+}
+
+void TokenBuffer::replace(int first, int count, const TokenBuffer &tokens, qsizetype shift)
+{
+    replaceRange(kinds, first, count, tokens.kinds);
+    replaceRange(offsets, first, count, tokens.offsets);
+    replaceRange(lengths, first, count, tokens.lengths);
+    replaceRange(indexes, first, count, tokens.indexes);
+    if(shift == 0) { return; }
+    // 位置以 32 位无符号数保存，负的平移量按模运算同样正确
+    quint32 delta = quint32(shift);
+    quint32 *data = offsets.data();
+    for(int i = first + tokens.size(); i < offsets.size(); i++) {
+        data[i] += delta;
+    }
+}
+
+void TokenBuffer::setIndex(int i, int index)
+{
+    indexes[i] = qint32(index);
+}
+
+int TokenBuffer::size() const
+{
+    return kinds.size();
+}
+
+TokenBuffer::Kind TokenBuffer::kind(int i) const
+{
+    return Kind(kinds.at(i));
+}
+
+qsizetype TokenBuffer::offset(int i) const
+{
+    return offsets.at(i);
+}
+
+qsizetype TokenBuffer::length(int i) const
+{
+    return lengths.at(i);
+}
+
+int TokenBuffer::index(int i) const
+{
+    return indexes.at(i);
+}
+
+int TokenBuffer::findEnd(qsizetype position) const
+{
+    int low = 0;
+    int high = size();
+    while(low < high) {
+        int mid = low + (high - low) / 2;
+        if(qsizetype(offsets.at(mid)) + qsizetype(lengths.at(mid)) < position) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+const char *TokenBuffer::mnemonicName(Kind kind, int index)
+{
+    switch (kind) {
+    case Kind::KEYWORD:
+        return LexTable::keywordName[index];
+    case Kind::OPERATOR:
+        return LexTable::operatorName[index];
+    case Kind::ID:
+        return "id";
+    case Kind::INTEGER:
+        return "integer";
+    case Kind::FLOAT:
+        return "floatnum";
+    case Kind::STRING:
+        return "string";
+    }
+    return "";
+}
+
+QString TokenBuffer::mnemonic(int i) const
+{
+    return QString::fromLatin1(mnemonicName(kind(i), index(i)));
+}
+
+QString TokenBuffer::text(int i) const
+{
+    QByteArray out;
+    appendText(i, out);
+    return QString::fromLatin1(out);
+}
+
+void TokenBuffer::appendText(int i, QByteArray &out) const
+{
+    Kind tokenKind = kind(i);
+    out.append("<$");
+    out.append(mnemonicName(tokenKind, index(i)));
+    out.append(", ");
+    if(tokenKind == Kind::KEYWORD || tokenKind == Kind::OPERATOR) {
+        out.append('-');
+    } else {
+        // 逆序写出十进制数字，避免 QByteArray::number 的临时对象
+        char digits[16];
+        int count = 0;
+        quint32 value = quint32(index(i));
+        do {
+            digits[count++] = char('0' + value % 10);
+            value /= 10;
+        } while(value != 0);
+        while(count > 0) { out.append(digits[--count]); }
+    }
+    out.append('>');
+}
@@ -0,0 +1,120 @@
+#ifndef TOKENBUFFER_H
+#define TOKENBUFFER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Token 序列缓冲区
+ * @details 按列分别存放每个 Token 的类型、源码位置、长度与表索引，每个 Token 占用 13 字节
+ *  关键字与操作符的表索引为 LexTable 中的枚举值，标识符与常量的表索引为其在对应表中的位置
+ *  "<$助记符, 索引>" 形式的文本只在显示或导出时才生成
+ *  源码位置与长度以字节计，以 32 位保存，分析前由 LexAnalyzer 保证源码不超过 MaxSourceSize
+ */
+class TokenBuffer
+{
+public:
+    /**
+     * @brief Token 类型
+     */
+    enum class Kind : quint8 {  KEYWORD=1, ID = 21, INTEGER = 22,
+                                FLOAT = 23, STRING = 24, OPERATOR=25 };
+
+    static constexpr qsizetype MaxSourceSize = 0xFFFFFFFF;  // 可以记录位置的最大源码字节数
+
+    TokenBuffer();
+
+    void clear();
+    void reserve(int count);
+    /**
+     * @brief truncate 只保留前 count 个 Token
+     * @param count 保留的 Token 数
+     */
+    void truncate(int count);
+
+    /**
+     * @brief append 追加一个 Token
+     * @param kind 类型
+     * @param offset 在源码中的起始字节位置，与 length 之和不超过 MaxSourceSize
+     * @param length 在源码中的字节数
+     * @param index 表索引
+     */
+    void append(Kind kind, qsizetype offset, qsizetype length, int index);
+    /**
+     * @brief append 将另一缓冲区中的全部 Token 追加到末尾
+     * @param other 另一缓冲区
+     */
+    void append(const TokenBuffer & other);
+    /**
+     * @brief append 将另一缓冲区中的 [first, first + count) 追加到末尾
+     * @param other 另一缓冲区
+     * @param first 起始序号
+     * @param count Token 数
+     */
+    void append(const TokenBuffer & other, int first, int count);
+    /**
+     * @brief replace 以另一缓冲区中的全部 Token 替换 [first, first + count)，其后 Token 的源码位置平移 shift 字节
+     * @details 替换前后数量相同的部分原位覆盖，用于增量分析后修补 Token 序列
+     * @param first 第一个被替换的 Token
+     * @param count 被替换的 Token 数
+     * @param tokens 替换后的 Token
+     * @param shift 其后 Token 源码位置的平移量
+     */
+    void replace(int first, int count, const TokenBuffer & tokens, qsizetype shift);
+    /**
+     * @brief setIndex 修改 Token 的表索引，用于合并分块识别的结果
+     * @param i Token 序号
+     * @param index 新的表索引
+     */
+    void setIndex(int i, int index);
+
+    int size() const;
+    Kind kind(int i) const;
+    qsizetype offset(int i) const;
+    qsizetype length(int i) const;
+    int index(int i) const;
+
+    /**
+     * @brief findEnd 查找第一个结束位置不小于 position 的 Token
+     * @details Token 按源码位置排列，二分查找
+     * @param position 源码字节位置
+     * @return Token 序号，没有时返回 size()
+     */
+    int findEnd(qsizetype position) const;
+
+    /**
+     * @brief mnemonic 获取 Token 的助记符
+     * @param i Token 序号
+     * @return 不带 '$' 前缀的助记符
+     */
+    QString mnemonic(int i) const;
+    /**
+     * @brief text 生成 Token 的显示文本
+     * @param i Token 序号
+     * @return "<$助记符, 索引>" 形式的文本
+     */
+    QString text(int i) const;
+    /**
+     * @brief appendText 将 Token 的显示文本以 UTF-8 追加到输出，不产生临时字符串
+     * @param i Token 序号
+     * @param out 输出缓冲区
+     */
+    void appendText(int i, QByteArray & out) const;
+
+private:
+    QVector<quint8> kinds;      // Token 类型
+    QVector<quint32> offsets;   // 源码起始字节位置
+    QVector<quint32> lengths;   // 源码字节数
+    QVector<qint32> indexes;    // 表索引
+
+    /**
+     * @brief mnemonicName 获取指定类型与索引的助记符
+     * @param kind 类型
+     * @param index 表索引
+     * @return 助记符，使用静态存储
+     */
+    static const char *mnemonicName(Kind kind, int index);
+};
+
+#endif // TOKENBUFFER_H
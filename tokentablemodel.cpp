@@ -0,0 +1,127 @@
+#include "tokentablemodel.h"
+
+#include <QBrush>
+
+TokenTableModel::TokenTableModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+    itemFont.setPointSize(10);
+    headerFont.setPointSize(11);
+    headerFont.setBold(true);
+}
+
+void TokenTableModel::setTokens(const TokenBuffer *tokens)
+{
+    beginResetModel();
+    this->tokens = tokens;
+    streamed.clear();
+    rows = tokens != nullptr ? tokens->size() : 0;
+    endResetModel();
+}
+
+void TokenTableModel::appendTokens(const TokenBuffer &batch)
+{
+    // 第一批非空的 Token 到达时才清空原有结果并开始追加
+    if(batch.size() == 0) {
+        return;
+    }
+    if(tokens != &streamed) {
+        setTokens(nullptr);
+        tokens = &streamed;
+    }
+    beginInsertRows(QModelIndex(), rows, rows + batch.size() - 1);
+    streamed.append(batch);
+    rows = streamed.size();
+    endInsertRows();
+}
+
+void TokenTableModel::attachTokens(const TokenBuffer *tokens)
+{
+    if(this->tokens != &streamed || tokens == nullptr || tokens->size() < rows) {
+        setTokens(tokens);
+        return;
+    }
+    this->tokens = tokens;
+    streamed.clear();
+    if(tokens->size() > rows) {
+        beginInsertRows(QModelIndex(), rows, tokens->size() - 1);
+        rows = tokens->size();
+        endInsertRows();
+    }
+}
+
+void TokenTableModel::applyPatch(const TokenBuffer *tokens, const LexAnalyzer::TokenPatch &patch)
+{
+    int oldNum = tokens->size() - patch.inserted + patch.removed;
+    // 表格与修改前的结果不一致时整体重新设置
+    if(this->tokens != tokens || rows != oldNum) {
+        setTokens(tokens);
+        return;
+    }
+    // 替换的行只需重绘，多出或缺少的部分再插入或删除
+    int common = qMin(patch.removed, patch.inserted);
+    if(common > 0) {
+        emit dataChanged(index(patch.first, 0), index(patch.first + common - 1, 0));
+    }
+    if(patch.removed > common) {
+        beginRemoveRows(QModelIndex(), patch.first + common, patch.first + patch.removed - 1);
+        rows -= patch.removed - common;
+        endRemoveRows();
+    } else if(patch.inserted > common) {
+        beginInsertRows(QModelIndex(), patch.first + common, patch.first + patch.inserted - 1);
+        rows += patch.inserted - common;
+        endInsertRows();
+    }
+    if(patch.isRenumbered && rows > 0) {
+        // 重新编号改变标识符与常量的索引，视图只重绘可见的行
+        emit dataChanged(index(0, 0), index(rows - 1, 0));
+    }
+}
+
+int TokenTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : rows;
+}
+
+int TokenTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : 1;
+}
+
+QVariant TokenTableModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid() || tokens == nullptr || index.row() >= rows || index.row() >= tokens->size()) {
+        return QVariant();
+    }
+    switch (role) {
+    case Qt::DisplayRole:
+        return tokens->text(index.row());
+    case Qt::FontRole:
+        return itemFont;
+    case Qt::ForegroundRole:
+        return QBrush(Qt::black);
+    case Qt::TextAlignmentRole:
+        return int(Qt::AlignHCenter | Qt::AlignVCenter);
+    default:
+        return QVariant();
+    }
+}
+
+QVariant TokenTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(orientation == Qt::Vertical) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (role) {
+    case Qt::DisplayRole:
+        return QString("语法单元");
+    case Qt::FontRole:
+        return headerFont;
+    case Qt::ForegroundRole:
+        return QBrush(Qt::black);
+    case Qt::TextAlignmentRole:
+        return int(Qt::AlignHCenter | Qt::AlignVCenter);
+    default:
+        return QVariant();
+    }
+}
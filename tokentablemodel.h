@@ -0,0 +1,63 @@
+#ifndef TOKENTABLEMODEL_H
+#define TOKENTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QFont>
+#include <QVariant>
+
+#include "lexanalyzer.h"
+#include "tokenbuffer.h"
+
+/**
+ * @brief 词法分析表的数据模型
+ * @details 直接引用分析器的 Token 表，视图只为可见的行请求数据，显示文本在请求时才生成，
+ *  展示任意规模的分析结果都不为每个 Token 创建表格项
+ *  后台分析过程中送来的 Token 暂存在模型中，分析完成后改为引用分析器的 Token 表
+ */
+class TokenTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit TokenTableModel(QObject *parent = nullptr);
+
+    /**
+     * @brief setTokens 展示给定的 Token 表
+     * @details 模型只保存指针，Token 表所属的分析器被替换前需要重新设置
+     * @param tokens Token 表，为空时清空表格
+     */
+    void setTokens(const TokenBuffer * tokens);
+    /**
+     * @brief appendTokens 在表格末尾追加后台分析过程中送来的 Token
+     * @details 模型未处于追加状态时，第一批非空的 Token 先清空原有结果，空的批次不改变表格
+     * @param batch 新识别出的 Token
+     */
+    void appendTokens(const TokenBuffer & batch);
+    /**
+     * @brief attachTokens 后台分析完成后改为引用分析器的 Token 表
+     * @details 已追加的 Token 是完整结果的前缀，只插入其后的行，视图的滚动位置不变
+     * @param tokens 完整的 Token 表
+     */
+    void attachTokens(const TokenBuffer * tokens);
+    /**
+     * @brief applyPatch 按增量分析的修改情况更新表格
+     * @details 模型未引用该 Token 表或行数与修改前不一致时整体重新设置
+     * @param tokens 已修改的 Token 表
+     * @param patch Token 表的修改
+     */
+    void applyPatch(const TokenBuffer * tokens, const LexAnalyzer::TokenPatch & patch);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    const TokenBuffer * tokens = nullptr;   // 展示的 Token 表，后台分析过程中指向 streamed
+    TokenBuffer streamed;   // 后台分析过程中送来的 Token
+    int rows = 0;           // 视图已知的行数
+    QFont itemFont;         // 单元格字体
+    QFont headerFont;       // 表头字体
+};
+
+#endif // TOKENTABLEMODEL_H